@@ -0,0 +1,90 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// One sided CUSUM (Page's test) for a step in a stream.
+// Each sample adds how far it is past the expected level, less a drift of
+// about half the smallest step worth catching. The sum is clipped at zero,
+// so noise around the level keeps it there; a real step makes it climb by
+// (step - drift) a sample until it crosses the threshold. The first sample
+// after it last left zero is where the step began, which is what
+// change_us() gives, ahead of when it's detected.
+// Latches on the first alarm until reset().
+class Cusum
+{
+public:
+  Cusum(float drift, float threshold) : _drift(drift), _threshold(threshold) {}
+
+  void reset()
+  {
+    _sum = 0;
+    _alarmed = false;
+    _change_us = 0;
+    _alarm_us = 0;
+  }
+
+  // deviation: the sample less the expected level, positive in the direction
+  // being watched. NAN samples are skipped. Returns true on the alarm.
+  bool add(float deviation, int64_t time_us)
+  {
+    if (_alarmed || isnan(deviation))
+    {
+      return false;
+    }
+    float sum = _sum + deviation - _drift;
+    if (sum <= 0)
+    {
+      _sum = 0;
+      return false;
+    }
+    if (_sum == 0)
+    {
+      _change_us = time_us;
+    }
+    _sum = sum;
+    if (_sum < _threshold)
+    {
+      return false;
+    }
+    _alarmed = true;
+    _alarm_us = time_us;
+    return true;
+  }
+
+  bool alarmed() const { return _alarmed; }
+  float sum() const { return _sum; }
+  int64_t change_us() const { return _change_us; }
+  int64_t alarm_us() const { return _alarm_us; }
+  int64_t latency_us() const { return _alarm_us - _change_us; }
+
+private:
+  float _drift;
+  float _threshold;
+  float _sum = 0;
+  bool _alarmed = false;
+  int64_t _change_us = 0;
+  int64_t _alarm_us = 0;
+};
@@ -0,0 +1,209 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+struct DecimatorSettings
+{
+  char name[12];
+  uint8_t cic_order;      // 1 to Decimator::MAX_ORDER
+  uint8_t cic_decimation; // 1 to Decimator::MAX_DECIMATION
+  bool half_band;         // then halve again through the FIR
+};
+
+// Multi-stage decimation of the load cell's conversions.
+// Stage one is a CIC: cic_order integrators at the input rate, the same number
+// of combs at the decimated rate, so it costs a few adds per sample whatever
+// the decimation. Integer and modular, so the integrators may wrap. Its
+// passband droops, so stage two, when enabled, is a 15 tap half band low pass
+// that decimates by two more and cleans up the CIC's aliasing. Both stages are
+// linear phase, so the delay is a constant number of input samples.
+class Decimator
+{
+public:
+  static const int MAX_ORDER = 4;
+  static const int MAX_DECIMATION = 32;
+  static const int HALF_BAND_TAPS = 15;
+
+  void configure(const DecimatorSettings &settings)
+  {
+    _settings = settings;
+    _order = (settings.cic_order < 1) ? 1 : (settings.cic_order > MAX_ORDER) ? MAX_ORDER : settings.cic_order;
+    _r = (settings.cic_decimation < 1) ? 1 : (settings.cic_decimation > MAX_DECIMATION) ? MAX_DECIMATION : settings.cic_decimation;
+    _cic_gain = powf(_r, _order);
+    _noise_gain = compute_noise_gain();
+    reset();
+  }
+
+  void reset()
+  {
+    for (int i = 0; i < MAX_ORDER; i++)
+    {
+      _integrators[i] = 0;
+      _combs[i] = 0;
+    }
+    for (int i = 0; i < HALF_BAND_TAPS; i++)
+    {
+      _history[i] = 0;
+    }
+    _phase = 0;
+    _history_head = 0;
+    _half = false;
+    _inputs = 0;
+    _output = NAN;
+  }
+
+  // Returns true when x completes an output. Nothing comes out until the
+  // filter has seen a full impulse response of input.
+  bool add(int32_t x)
+  {
+    uint64_t sum = (uint64_t)(int64_t)x;
+    for (int i = 0; i < _order; i++)
+    {
+      _integrators[i] += sum;
+      sum = _integrators[i];
+    }
+    _inputs += (_inputs < warmup()) ? 1 : 0;
+    if (++_phase < _r)
+    {
+      return false;
+    }
+    _phase = 0;
+    for (int i = 0; i < _order; i++)
+    {
+      uint64_t previous = _combs[i];
+      _combs[i] = sum;
+      sum -= previous;
+    }
+    float cic = (double)(int64_t)sum / _cic_gain; // float alone would lose counts
+    if (_settings.half_band)
+    {
+      _history[_history_head] = cic;
+      _history_head = (_history_head + 1) % HALF_BAND_TAPS;
+      _half = !_half;
+      if (_half)
+      {
+        return false;
+      }
+      // Taps summing to one, about the centre tap so a constant passes exactly
+      // and float rounding works on small differences. Symmetric, so the
+      // order doesn't matter.
+      float centre = _history[(_history_head + HALF_BAND_TAPS / 2) % HALF_BAND_TAPS];
+      float y = 0;
+      for (int j = 0; j < HALF_BAND_TAPS; j++)
+      {
+        y += HALF_BAND[j] * (_history[(_history_head + j) % HALF_BAND_TAPS] - centre);
+      }
+      cic = centre + y;
+    }
+    if (_inputs < warmup())
+    {
+      return false;
+    }
+    _output = cic;
+    return true;
+  }
+
+  float output() const { return _output; } // counts
+
+  const DecimatorSettings &settings() const { return _settings; }
+  int decimation() const { return _r * (_settings.half_band ? 2 : 1); }
+
+  // In input samples
+  float group_delay() const
+  {
+    return _order * (_r - 1) / 2.0f + (_settings.half_band ? (HALF_BAND_TAPS - 1) / 2.0f * _r : 0);
+  }
+
+  // Output variance over input variance, for white noise
+  float noise_gain() const { return _noise_gain; }
+
+private:
+  static constexpr float HALF_BAND[HALF_BAND_TAPS] = {
+      -0.003651, 0, 0.016179, 0, -0.068412, 0, 0.304948, 0.501873,
+      0.304948, 0, -0.068412, 0, 0.016179, 0, -0.003651};
+
+  int warmup() const { return _order * (_r - 1) + 1 + (_settings.half_band ? (HALF_BAND_TAPS - 1) * _r : 0); }
+
+  // The CIC's impulse response is a box of r convolved order times. The
+  // half band's taps are r inputs apart, so its cross terms only need the
+  // CIC's autocorrelation at multiples of r.
+  float compute_noise_gain() const
+  {
+    const int length = MAX_ORDER * (MAX_DECIMATION - 1) + 1;
+    float h[length] = {1};
+    int n = 1;
+    for (int stage = 0; stage < _order; stage++)
+    {
+      n += _r - 1;
+      for (int i = n - 1; i >= 0; i--) // running sum over the last r
+      {
+        float sum = 0;
+        for (int k = 0; k < _r && k <= i; k++)
+        {
+          sum += h[i - k];
+        }
+        h[i] = sum / _r;
+      }
+    }
+    float autocorrelation[MAX_ORDER + 1] = {};
+    for (int d = 0; d <= MAX_ORDER && d * _r < n; d++)
+    {
+      for (int i = 0; i + d * _r < n; i++)
+      {
+        autocorrelation[d] += h[i] * h[i + d * _r];
+      }
+    }
+    if (!_settings.half_band)
+    {
+      return autocorrelation[0];
+    }
+    float gain = 0;
+    for (int j = 0; j < HALF_BAND_TAPS; j++)
+    {
+      for (int k = 0; k < HALF_BAND_TAPS; k++)
+      {
+        int d = (j > k) ? j - k : k - j;
+        gain += (d <= MAX_ORDER) ? HALF_BAND[j] * HALF_BAND[k] * autocorrelation[d] : 0;
+      }
+    }
+    return gain;
+  }
+
+  DecimatorSettings _settings = {"", 1, 1, false};
+  int _order = 1;
+  int _r = 1;
+  float _cic_gain = 1;
+  float _noise_gain = 1;
+  uint64_t _integrators[MAX_ORDER] = {};
+  uint64_t _combs[MAX_ORDER] = {};
+  int _phase = 0;
+  float _history[HALF_BAND_TAPS] = {}; // CIC outputs, oldest at _history_head
+  int _history_head = 0;
+  bool _half = false;
+  int _inputs = 0;
+  float _output = NAN;
+};
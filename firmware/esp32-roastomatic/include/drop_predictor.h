@@ -0,0 +1,124 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <math.h>
+
+#include "ror_estimator.h"
+
+// What ends a roast: the beans have lost this percent of the charge's weight,
+// or reached this temperature. NAN leaves either out.
+struct DropTargets
+{
+  float loss_percent;
+  float end_f;
+};
+
+// Time left until the roast reaches its drop targets.
+// The mass-loss rate and how fast the rate of rise is falling are least
+// squares slopes over the last WINDOW samples, taken once a sample period.
+// The weight and temperature they're applied to are the latest, so the
+// countdown moves every update. Everything is O(1) per update.
+template <int WINDOW>
+class DropPredictor
+{
+public:
+  explicit DropPredictor(float sample_period_s)
+      : _sample_period_s(sample_period_s), _mass(sample_period_s), _ror(sample_period_s) {}
+
+  void reset(float charge_g)
+  {
+    _charge_g = charge_g;
+    _mass.reset();
+    _ror.reset();
+    _since_sample_s = 0;
+    _grams = NAN;
+    _bean_f = NAN;
+    _ror_f_per_min = NAN;
+  }
+
+  // Every control pass
+  void update(float grams, float bean_f, float ror_f_per_min, float dt_s)
+  {
+    _grams = grams;
+    _bean_f = bean_f;
+    _ror_f_per_min = ror_f_per_min;
+    _since_sample_s += dt_s;
+    if (_since_sample_s >= _sample_period_s)
+    {
+      _since_sample_s -= _sample_period_s;
+      _mass.add(grams);
+      _ror.add(ror_f_per_min);
+    }
+  }
+
+  // Percent of the charge a minute, positive as it loses water
+  float loss_percent_per_min() const { return -_mass.f_per_minute() * 100 / _charge_g; }
+
+  // NAN if the weight isn't falling
+  float seconds_to_loss(float loss_percent) const
+  {
+    float rate_g_per_min = -_mass.f_per_minute();
+    float remaining_g = _grams - _charge_g * (1 - loss_percent / 100);
+    if (remaining_g <= 0)
+    {
+      return 0;
+    }
+    return (rate_g_per_min > 0) ? remaining_g / rate_g_per_min * 60 : NAN;
+  }
+
+  // The rate of rise carried forward, falling as fast as it has been. A
+  // rising one isn't extrapolated. NAN if it would reach zero short of end_f.
+  float seconds_to_temperature(float end_f) const
+  {
+    float remaining_f = end_f - _bean_f;
+    if (remaining_f <= 0)
+    {
+      return 0;
+    }
+    float rate = _ror_f_per_min;
+    float change = fminf(_ror.f_per_minute(), 0); // F/min per minute
+    float discriminant = rate * rate + 2 * change * remaining_f;
+    if (!(rate > 0) || !(discriminant >= 0))
+    {
+      return NAN;
+    }
+    return 2 * remaining_f / (rate + sqrtf(discriminant)) * 60;
+  }
+
+  // The sooner of the two
+  float seconds_remaining(const DropTargets &targets) const
+  {
+    return fminf(seconds_to_loss(targets.loss_percent), seconds_to_temperature(targets.end_f));
+  }
+
+private:
+  float _sample_period_s;
+  RorEstimator<WINDOW> _mass; // grams, for the slope
+  RorEstimator<WINDOW> _ror;  // F/min
+  float _since_sample_s = 0;
+  float _charge_g = NAN;
+  float _grams = NAN;
+  float _bean_f = NAN;
+  float _ror_f_per_min = NAN;
+};
@@ -0,0 +1,171 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Streaming Hampel filter: a sample further than threshold robust standard
+// deviations from the median of the last WINDOW samples is an outlier and is
+// replaced by that median.
+// The window is kept sorted next to an arrival ring. Each new sample finds
+// the oldest's slot and its own by binary search and shifts only the entries
+// between them, so the median is an index and the IQR is two. The MAD takes
+// a WINDOW/2 step walk outward from the median.
+// Samples go into the window unfiltered, so a real step is accepted once it
+// holds for half the window. min_scale keeps a quiet, quantized signal, whose
+// spread can be zero, from rejecting its next count.
+template <int WINDOW>
+class HampelFilter
+{
+  static_assert(WINDOW % 2 == 1 && WINDOW >= 3, "the window needs a middle sample");
+
+public:
+  enum Scale
+  {
+    MAD, // median absolute deviation * 1.4826, the classic Hampel
+    IQR, // interquartile range / 1.349, cheaper but fooled by 2 spikes in 8
+  };
+
+  HampelFilter(float threshold, float min_scale, Scale scale = MAD)
+      : _threshold(threshold), _min_scale(min_scale), _scale(scale) {}
+
+  void reset()
+  {
+    _count = 0;
+    _head = 0;
+  }
+
+  // NAN passes through and stays out of the window. Until the window fills
+  // there's no median to trust, so samples pass through.
+  float filter(float x)
+  {
+    if (isnan(x))
+    {
+      return x;
+    }
+    push(x);
+    if (_count < WINDOW)
+    {
+      return x;
+    }
+    float median = _sorted[WINDOW / 2];
+    float scale = spread(median);
+    scale = (scale > _min_scale) ? scale : _min_scale;
+    if (fabsf(x - median) > _threshold * scale)
+    {
+      _rejected++;
+      return median;
+    }
+    return x;
+  }
+
+  uint32_t rejected() const { return _rejected; }
+
+private:
+  // First index in the sorted window of length n not less than x
+  int lower_bound(float x, int n) const
+  {
+    int low = 0;
+    while (n > 0)
+    {
+      int half = n / 2;
+      if (_sorted[low + half] < x)
+      {
+        low += half + 1;
+        n -= half + 1;
+      }
+      else
+      {
+        n = half;
+      }
+    }
+    return low;
+  }
+
+  void push(float x)
+  {
+    if (_count < WINDOW)
+    {
+      int at = lower_bound(x, _count);
+      memmove(&_sorted[at + 1], &_sorted[at], (_count - at) * sizeof(float));
+      _sorted[at] = x;
+      _arrival[_count++] = x;
+      return;
+    }
+    // Take the oldest out and put x in with one shift between the two slots
+    int from = lower_bound(_arrival[_head], WINDOW);
+    int to = lower_bound(x, WINDOW);
+    if (to > from)
+    {
+      to--; // the slot just below x once the oldest is gone
+      memmove(&_sorted[from], &_sorted[from + 1], (to - from) * sizeof(float));
+    }
+    else
+    {
+      memmove(&_sorted[to + 1], &_sorted[to], (from - to) * sizeof(float));
+    }
+    _sorted[to] = x;
+    _arrival[_head] = x;
+    _head = (_head + 1) % WINDOW;
+  }
+
+  float spread(float median) const
+  {
+    if (_scale == IQR)
+    {
+      return (_sorted[3 * WINDOW / 4] - _sorted[WINDOW / 4]) / 1.349f;
+    }
+    // The WINDOW/2-th smallest distance from the median, merging outward
+    int below = WINDOW / 2 - 1;
+    int above = WINDOW / 2 + 1;
+    float distance = 0;
+    for (int k = 0; k < WINDOW / 2; k++)
+    {
+      float down = (below >= 0) ? median - _sorted[below] : INFINITY;
+      float up = (above < WINDOW) ? _sorted[above] - median : INFINITY;
+      if (down <= up)
+      {
+        distance = down;
+        below--;
+      }
+      else
+      {
+        distance = up;
+        above++;
+      }
+    }
+    return 1.4826f * distance;
+  }
+
+  float _threshold;
+  float _min_scale;
+  Scale _scale;
+  float _sorted[WINDOW] = {};
+  float _arrival[WINDOW] = {}; // ring, oldest at _head once full
+  int _count = 0;
+  int _head = 0;
+  uint32_t _rejected = 0;
+};
@@ -0,0 +1,85 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Spreads heater power over mains half-cycles as evenly as possible.
+// This is a first order sigma-delta (Bresenham's line): every half-cycle the
+// duty is added to an accumulator, and the SSR is on for that half-cycle when
+// the accumulator passes full scale. Any duty d out of full scale f gives d
+// half-cycles on in every f, and the on half-cycles are never bunched together
+// by more than one, so the power in any window is within one half-cycle of the
+// ideal. No hardware in here; next_half_cycle() is driven by a timer on the
+// device and by a simulated mains clock in test/test_heater_modulator.
+class HeaterModulator
+{
+public:
+  explicit HeaterModulator(uint16_t full_scale) : _full_scale(full_scale) {}
+
+  // Any context. Clamped to full scale.
+  void set_duty(uint16_t duty)
+  {
+    _duty.store((duty < _full_scale) ? duty : _full_scale, std::memory_order_relaxed);
+  }
+  uint16_t duty() const { return _duty.load(std::memory_order_relaxed); }
+  uint16_t full_scale() const { return _full_scale; }
+
+  // Off, with the counters and the accumulated error cleared
+  void reset()
+  {
+    set_duty(0);
+    _error = _full_scale / 2;
+    _count = 0;
+    _on_count = 0;
+  }
+
+  // Once per half-cycle. Returns whether the SSR should conduct for it.
+  bool next_half_cycle()
+  {
+    _error += duty();
+    bool on = _error >= _full_scale;
+    if (on)
+    {
+      _error -= _full_scale;
+      _on_count++;
+    }
+    _count++;
+    return on;
+  }
+
+  uint32_t half_cycles() const { return _count; }
+  uint32_t half_cycles_on() const { return _on_count; }
+
+  // Half-cycle period for a mains frequency, in microseconds
+  static uint32_t half_cycle_us(uint32_t mains_hz) { return 1000000 / (2 * mains_hz); }
+
+private:
+  uint16_t _full_scale;
+  std::atomic<uint16_t> _duty{0};
+  uint32_t _error = _full_scale / 2; // centres each on half-cycle in its interval
+  volatile uint32_t _count = 0;
+  volatile uint32_t _on_count = 0;
+};
@@ -0,0 +1,74 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "hampel_filter.h"
+#include "ring_buffer.h"
+
+struct Hx711Sample
+{
+  int32_t raw;
+  int64_t time_us; // when DT fell
+};
+
+// HX711 load cell amplifier driven from the DT falling edge.
+// The interrupt clocks each conversion out as soon as it's ready and pushes it
+// with a timestamp into a ring, so no conversion is missed and nothing in the
+// control loop waits on the chip. pop() drains the ring and replaces
+// vibration spikes with the recent median; the caller decimates.
+// Tie the chip's RATE pin high for 80 samples per second.
+class Hx711Reader
+{
+public:
+  static const uint32_t RING_SIZE = 64;
+  static const int SPIKE_WINDOW = 7;
+  static constexpr float SPIKE_THRESHOLD = 3.0; // robust standard deviations
+  static constexpr float SPIKE_MIN_COUNTS = 100; // about a quarter gram
+
+  Hx711Reader(int dt_pin, int sck_pin);
+
+  void begin(); // Attach the interrupt. Safe to call again.
+  void end();   // Detach so the HX711 library can drive the chip
+
+  // Consumer side, control task only
+  bool pop(Hx711Sample &sample);
+
+  uint32_t captured() const { return _captured; }
+  uint32_t dropped() const { return _dropped; }
+  uint32_t spikes() const { return _spikes.rejected(); }
+
+private:
+  static void isr(void *arg);
+
+  int _dt_pin;
+  int _sck_pin;
+  bool _attached = false;
+
+  RingBuffer<Hx711Sample, RING_SIZE> _samples;
+  HampelFilter<SPIKE_WINDOW> _spikes{SPIKE_THRESHOLD, SPIKE_MIN_COUNTS};
+  volatile uint32_t _captured = 0;
+  volatile uint32_t _dropped = 0;
+};
@@ -0,0 +1,114 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+
+// Summary of one stats window
+struct JitterSummary
+{
+  uint32_t min_us;
+  uint32_t mean_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+  uint32_t count;
+  uint32_t missed; // ticks that fired while the previous one was still running
+};
+
+// Tracks how late each control tick started relative to its ideal time.
+// Lateness goes into a fixed histogram so p99 costs nothing per tick and
+// only a short walk once per window.
+struct JitterStats
+{
+  static const uint32_t BIN_US = 10;
+  static const int NUM_BINS = 128; // The last bin holds everything >= 1270us
+
+  uint32_t window_us;
+  JitterSummary last = {0, 0, 0, 0, 0, 0};
+
+  uint32_t bins[NUM_BINS] = {};
+  uint32_t window_start_us = 0;
+  uint32_t min_us = UINT32_MAX;
+  uint32_t max_us = 0;
+  uint64_t sum_us = 0;
+  uint32_t count = 0;
+  uint32_t missed = 0;
+
+  explicit JitterStats(uint32_t window_us) : window_us(window_us) {}
+
+  // Returns true when a window has just been completed
+  bool record(uint32_t now_us, uint32_t late_us, uint32_t missed_ticks)
+  {
+    if (count == 0 && window_start_us == 0)
+    {
+      window_start_us = now_us;
+    }
+
+    uint32_t bin = late_us / BIN_US;
+    bins[(bin < NUM_BINS) ? bin : NUM_BINS - 1]++;
+    min_us = (late_us < min_us) ? late_us : min_us;
+    max_us = (late_us > max_us) ? late_us : max_us;
+    sum_us += late_us;
+    count++;
+    missed += missed_ticks;
+
+    if (now_us - window_start_us < window_us)
+    {
+      return false;
+    }
+    last = {min_us, (uint32_t)(sum_us / count), percentile(99), max_us, count, missed};
+    reset(now_us);
+    return true;
+  }
+
+  // Upper edge of the bin holding the given percentile, clamped to the max seen
+  uint32_t percentile(int p) const
+  {
+    uint32_t target = ((uint64_t)count * p + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < NUM_BINS; i++)
+    {
+      seen += bins[i];
+      if (seen >= target)
+      {
+        uint32_t edge = (i + 1) * BIN_US;
+        return (edge < max_us) ? edge : max_us;
+      }
+    }
+    return max_us;
+  }
+
+  void reset(uint32_t now_us)
+  {
+    for (int i = 0; i < NUM_BINS; i++)
+    {
+      bins[i] = 0;
+    }
+    window_start_us = now_us;
+    min_us = UINT32_MAX;
+    max_us = 0;
+    sum_us = 0;
+    count = 0;
+    missed = 0;
+  }
+};
@@ -0,0 +1,76 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <driver/ledc.h>
+#include <stdint.h>
+
+// One LEDC channel behind a change-coalescing output stage.
+// write() is called every control pass with the wanted duty. The duty is
+// quantized with a hysteresis of one quantum so pot jitter doesn't reach the
+// pin, optionally slew limited, and the registers are only touched when the
+// quantized duty actually moves. With fades on, the LEDC hardware ramps to the
+// new duty over the time the slew limit allows, and a change that arrives
+// while a fade is running waits for it to finish.
+class LedcActuator
+{
+public:
+  // quantum:       duty counts per output step
+  // slew_per_s:    largest duty change per second, 0 for no limit
+  // fade:          let the LEDC hardware do the slewing
+  LedcActuator(ledc_mode_t mode, ledc_channel_t channel, uint32_t quantum,
+               uint32_t slew_per_s, bool fade);
+
+  void begin(); // After ledc_channel_config()
+
+  // Returns true when the registers were written
+  bool write(uint32_t duty, int64_t now_us);
+
+  uint32_t duty() const { return _duty; } // last duty written
+  uint32_t writes() const { return _writes; }
+  uint32_t coalesced() const { return _coalesced; }
+  uint32_t writes_per_second() const { return _writes_per_second; }
+
+private:
+  static const int64_t RATE_WINDOW_US = 1000000;
+
+  uint32_t quantize(uint32_t duty);
+
+  ledc_mode_t _mode;
+  ledc_channel_t _channel;
+  uint32_t _quantum;
+  uint32_t _slew_per_s;
+  bool _fade;
+
+  uint32_t _level = 0;  // quantized target
+  uint32_t _duty = 0;   // in the registers
+  int64_t _last_us = 0; // previous write() call
+  int64_t _fade_end_us = 0;
+
+  uint32_t _writes = 0;
+  uint32_t _coalesced = 0;
+  uint32_t _window_writes = 0;
+  int64_t _window_start_us = 0;
+  uint32_t _writes_per_second = 0;
+};
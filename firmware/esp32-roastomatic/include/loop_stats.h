@@ -0,0 +1,82 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+
+// Summary of one stats window
+struct LoopPeriod
+{
+  uint32_t min_us;
+  uint32_t mean_us;
+  uint32_t max_us;
+  uint32_t count;
+};
+
+// Measures the period between successive calls to record().
+// Every window_us the running figures are rolled into last and restarted,
+// so min and max describe recent behaviour instead of the whole boot.
+struct LoopStats
+{
+  uint32_t window_us;
+  LoopPeriod last = {0, 0, 0, 0};
+
+  uint32_t last_call_us = 0;
+  uint32_t window_start_us = 0;
+  uint32_t min_us = UINT32_MAX;
+  uint32_t max_us = 0;
+  uint64_t sum_us = 0;
+  uint32_t count = 0;
+
+  explicit LoopStats(uint32_t window_us) : window_us(window_us) {}
+
+  // Returns true when a window has just been completed
+  bool record(uint32_t now_us)
+  {
+    if (last_call_us == 0)
+    {
+      last_call_us = now_us;
+      window_start_us = now_us;
+      return false;
+    }
+
+    uint32_t period = now_us - last_call_us; // unsigned math survives wrap
+    last_call_us = now_us;
+    min_us = (period < min_us) ? period : min_us;
+    max_us = (period > max_us) ? period : max_us;
+    sum_us += period;
+    count++;
+
+    if (now_us - window_start_us < window_us)
+    {
+      return false;
+    }
+    last = {min_us, (uint32_t)(sum_us / count), max_us, count};
+    window_start_us = now_us;
+    min_us = UINT32_MAX;
+    max_us = 0;
+    sum_us = 0;
+    count = 0;
+    return true;
+  }
+};
@@ -0,0 +1,79 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <driver/spi_master.h>
+#include <math.h>
+#include <stdint.h>
+
+// Both MAX6675 thermocouple amplifiers on one hardware SPI bus.
+// This is the bus's only user. poll() never waits: when a read is due it
+// queues one 16 bit transfer per chip, the SPI driver clocks them out back to
+// back from its interrupt, and later polls collect them. Readings are
+// published in pairs. Reads are spaced so the chips always have a full
+// conversion time after CS goes high, so a read never lands mid-conversion.
+class Max6675Bus
+{
+public:
+  static const int NUM_CHIPS = 2;
+  static const uint32_t CONVERSION_US = 220000; // Worst case from the datasheet
+  static const int CLOCK_HZ = 1000000;          // Chip tops out at 4.3MHz
+
+  Max6675Bus(const int (&cs_pins)[NUM_CHIPS], uint32_t period_us);
+
+  void begin(spi_host_device_t host, int sck_pin, int so_pin);
+
+  // Call every control pass. Returns true when new values were published.
+  bool poll(int64_t now_us);
+
+  float readFarenheit(int chip) const { return _chips[chip].temp_f; }
+  bool is_open(int chip) const { return _chips[chip].open; }
+
+  // Read cost bookkeeping, for both chips together
+  uint32_t reads() const { return _reads; }
+  uint32_t cpu_us_max() const { return _cpu_us_max; }      // CPU time spent in poll() for one read
+  uint32_t transfer_us_last() const { return _transfer_us; } // first queued to last collected
+
+private:
+  struct Chip
+  {
+    int cs_pin;
+    spi_device_handle_t device = NULL;
+    spi_transaction_t transaction = {};
+    bool collected = false;
+    float temp_f = NAN;
+    bool open = false;
+  };
+
+  Chip _chips[NUM_CHIPS];
+  uint32_t _period_us;
+  bool _in_flight = false;
+  int64_t _queued_us = 0;
+  int64_t _next_read_us = 0;
+
+  uint32_t _reads = 0;
+  uint32_t _cpu_us = 0;
+  uint32_t _cpu_us_max = 0;
+  uint32_t _transfer_us = 0;
+};
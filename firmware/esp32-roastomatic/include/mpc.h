@@ -0,0 +1,282 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+
+// Lumped thermal model of the popper, two states a second apart:
+//   air:  the intake thermocouple, driven toward ambient + rise * duty
+//   bean: driven toward the air
+// More airflow carries the heat away faster, so the air rise falls as 1/fan,
+// and it also speeds heat into the beans, roughly as sqrt(fan). A bigger
+// charge takes proportionally longer to heat. Fit from a logged roast with
+// software/python roastomatic.thermal.
+struct ThermalModel
+{
+  float ambient_f;
+  float air_rise_f;          // steady air rise over ambient at full heat and full fan
+  float air_tau_s;
+  float bean_tau_s_per_100g; // at full fan
+};
+
+struct ThermalState
+{
+  float air_f;
+  float bean_f;
+};
+
+// Model predictive control of the heater duty.
+// The duty over the horizon is three held blocks, short first, so the
+// problem is a 3 variable box constrained QP: track the setpoint trajectory
+// with a penalty on duty moves. It is built from four simulations of the
+// model and solved exactly when the unconstrained optimum is in bounds, or by
+// a fixed number of projected gradient steps when it isn't, so the worst case
+// time is bounded and known.
+class MpcController
+{
+public:
+  static const int HORIZON = 60; // steps
+  static const int MOVES = 3;
+  static constexpr float STEP_S = 1.0;
+  static const int ITERATIONS = 64;
+
+  MpcController(const ThermalModel &model, float move_penalty)
+      : _model(model), _move_penalty(move_penalty) {}
+
+  void set_model(const ThermalModel &model) { _model = model; }
+  const ThermalModel &model() const { return _model; }
+
+  // setpoint_f[k] is the target bean temperature k + 1 steps ahead.
+  // fan is 0 to 1, duties are 0 to 1. Returns the duty to apply now.
+  float solve(const ThermalState &state, float fan, float bean_mass_g,
+              const float *setpoint_f, float previous_duty)
+  {
+    configure(fan, bean_mass_g);
+
+    // Predictions are linear in the block duties: bean = free + G u
+    float free[HORIZON];
+    simulate(state, nullptr, free);
+    float gains[MOVES][HORIZON];
+    for (int j = 0; j < MOVES; j++)
+    {
+      float unit[MOVES] = {};
+      unit[j] = 1;
+      simulate({_model.ambient_f, _model.ambient_f}, unit, gains[j]);
+      for (int k = 0; k < HORIZON; k++)
+      {
+        // response from rest to a unit block, less the rest itself
+        gains[j][k] -= _model.ambient_f;
+      }
+    }
+
+    // 1/2 u'Hu + c'u, with moves d = Du - (previous, 0, 0)
+    float h[MOVES][MOVES] = {};
+    float c[MOVES] = {};
+    for (int i = 0; i < MOVES; i++)
+    {
+      for (int k = 0; k < HORIZON; k++)
+      {
+        c[i] += gains[i][k] * (free[k] - setpoint_f[k]);
+        for (int j = i; j < MOVES; j++)
+        {
+          h[i][j] += gains[i][k] * gains[j][k];
+        }
+      }
+    }
+    for (int i = 0; i < MOVES; i++)
+    {
+      for (int j = 0; j < i; j++)
+      {
+        h[i][j] = h[j][i];
+      }
+    }
+    // D'D for first differences with the previous duty ahead of u0
+    float lambda = _move_penalty;
+    for (int i = 0; i < MOVES; i++)
+    {
+      h[i][i] += lambda * ((i == MOVES - 1) ? 1 : 2);
+      if (i + 1 < MOVES)
+      {
+        h[i][i + 1] -= lambda;
+        h[i + 1][i] -= lambda;
+      }
+    }
+    c[0] -= lambda * previous_duty;
+
+    // Held at the previous duty if the system is too near singular to solve
+    float u[MOVES];
+    for (int i = 0; i < MOVES; i++)
+    {
+      u[i] = previous_duty;
+    }
+    if (!solve_unconstrained(h, c, u) || !in_bounds(u))
+    {
+      project(u);
+      // Gershgorin bound on the largest eigenvalue gives a safe step
+      float lipschitz = 0;
+      for (int i = 0; i < MOVES; i++)
+      {
+        float row = 0;
+        for (int j = 0; j < MOVES; j++)
+        {
+          row += fabsf(h[i][j]);
+        }
+        lipschitz = fmaxf(lipschitz, row);
+      }
+      for (int iteration = 0; lipschitz > 0 && iteration < ITERATIONS; iteration++)
+      {
+        float next[MOVES];
+        for (int i = 0; i < MOVES; i++)
+        {
+          float gradient = c[i];
+          for (int j = 0; j < MOVES; j++)
+          {
+            gradient += h[i][j] * u[j];
+          }
+          next[i] = u[i] - gradient / lipschitz;
+        }
+        project(next);
+        for (int i = 0; i < MOVES; i++)
+        {
+          u[i] = next[i];
+        }
+      }
+    }
+    for (int k = 0; k < HORIZON; k++)
+    {
+      _predicted_f[k] = free[k];
+      for (int j = 0; j < MOVES; j++)
+      {
+        _predicted_f[k] += gains[j][k] * u[j];
+      }
+    }
+    return u[0];
+  }
+
+  // Bean temperature the last solve expects, step by step
+  const float *predicted_f() const { return _predicted_f; }
+
+  // One model step, for simulation
+  ThermalState step(const ThermalState &state, float duty, float fan, float bean_mass_g)
+  {
+    configure(fan, bean_mass_g);
+    return advance(state, duty);
+  }
+
+  // How fast the model heats the beans toward the air right now, F/s
+  float bean_rate_f_per_s(const ThermalState &state, float fan, float bean_mass_g) const
+  {
+    return (state.air_f - state.bean_f) / fmaxf(bean_tau_s(fan, bean_mass_g), STEP_S);
+  }
+
+private:
+  // Block k ranges: [0, 4), [4, 16), [16, HORIZON)
+  static int block(int k) { return (k < 4) ? 0 : (k < 16) ? 1 : 2; }
+
+  void configure(float fan, float bean_mass_g)
+  {
+    _rise_f = _model.air_rise_f / fmaxf(fan, MIN_FAN);
+    _air_alpha = 1 - expf(-STEP_S / _model.air_tau_s);
+    _bean_alpha = 1 - expf(-STEP_S / fmaxf(bean_tau_s(fan, bean_mass_g), STEP_S));
+  }
+
+  float bean_tau_s(float fan, float bean_mass_g) const
+  {
+    return _model.bean_tau_s_per_100g * (bean_mass_g / 100) / sqrtf(fmaxf(fan, MIN_FAN));
+  }
+
+  ThermalState advance(const ThermalState &state, float duty) const
+  {
+    ThermalState next;
+    next.air_f = state.air_f + _air_alpha * (_model.ambient_f + _rise_f * duty - state.air_f);
+    next.bean_f = state.bean_f + _bean_alpha * (state.air_f - state.bean_f);
+    return next;
+  }
+
+  void simulate(ThermalState state, const float *blocks, float *bean_f) const
+  {
+    for (int k = 0; k < HORIZON; k++)
+    {
+      state = advance(state, blocks ? blocks[block(k)] : 0);
+      bean_f[k] = state.bean_f;
+    }
+  }
+
+  static bool solve_unconstrained(const float h[MOVES][MOVES], const float *c, float *u)
+  {
+    // Cramer's rule is plenty for 3x3
+    float det = h[0][0] * (h[1][1] * h[2][2] - h[1][2] * h[2][1]) -
+                h[0][1] * (h[1][0] * h[2][2] - h[1][2] * h[2][0]) +
+                h[0][2] * (h[1][0] * h[2][1] - h[1][1] * h[2][0]);
+    if (fabsf(det) < 1e-12f)
+    {
+      return false;
+    }
+    for (int col = 0; col < MOVES; col++)
+    {
+      float m[MOVES][MOVES];
+      for (int i = 0; i < MOVES; i++)
+      {
+        for (int j = 0; j < MOVES; j++)
+        {
+          m[i][j] = (j == col) ? -c[i] : h[i][j];
+        }
+      }
+      u[col] = (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) /
+               det;
+    }
+    return true;
+  }
+
+  static bool in_bounds(const float *u)
+  {
+    for (int i = 0; i < MOVES; i++)
+    {
+      if (!(u[i] >= 0 && u[i] <= 1))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void project(float *u)
+  {
+    for (int i = 0; i < MOVES; i++)
+    {
+      u[i] = isnan(u[i]) ? 0 : fminf(fmaxf(u[i], 0), 1);
+    }
+  }
+
+  static constexpr float MIN_FAN = 0.2; // the popper won't run slower
+
+  ThermalModel _model;
+  float _move_penalty;
+  float _rise_f = 0;
+  float _air_alpha = 0;
+  float _bean_alpha = 0;
+  float _predicted_f[HORIZON] = {};
+};
@@ -0,0 +1,101 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+struct PidGains
+{
+  float kp; // output per degree
+  float ki; // output per degree second
+  float kd; // output seconds per degree
+};
+
+// Fixed-rate PID for the bean temperature.
+// - The integral is kept in output units, so changing gains mid roast doesn't
+//   bump the output.
+// - Derivative on measurement, low pass filtered, so a setpoint step doesn't
+//   kick the heater and thermocouple quantization doesn't reach it.
+// - Conditional integration: the integral only moves toward saturation while
+//   the output isn't already there, and never leaves the output range, so
+//   a long stretch at full heat doesn't wind up an overshoot.
+// - initialize() starts from whatever output is already applied, for bumpless
+//   transfer from manual.
+class Pid
+{
+public:
+  Pid(float out_min, float out_max, float derivative_tau_s)
+      : _out_min(out_min), _out_max(out_max), _derivative_tau_s(derivative_tau_s) {}
+
+  void set_gains(const PidGains &gains) { _gains = gains; }
+  const PidGains &gains() const { return _gains; }
+
+  void initialize(float setpoint, float measurement, float output)
+  {
+    _last_measurement = measurement;
+    _slope = 0;
+    _integral = clamp(output - _gains.kp * (setpoint - measurement));
+    _output = clamp(output);
+  }
+
+  float update(float setpoint, float measurement, float dt_s)
+  {
+    float error = setpoint - measurement;
+    float proportional = _gains.kp * error;
+
+    float slope = (measurement - _last_measurement) / dt_s;
+    _last_measurement = measurement;
+    _slope += (dt_s / (_derivative_tau_s + dt_s)) * (slope - _slope);
+    float derivative = -_gains.kd * _slope;
+
+    float integral = _integral + _gains.ki * error * dt_s;
+    float unsaturated = proportional + integral + derivative;
+    bool winding_up = (unsaturated > _out_max && error > 0) || (unsaturated < _out_min && error < 0);
+    if (!winding_up)
+    {
+      _integral = clamp(integral);
+    }
+
+    _output = clamp(proportional + _integral + derivative);
+    return _output;
+  }
+
+  float output() const { return _output; }
+  float integral() const { return _integral; }
+  float slope() const { return _slope; } // filtered, per second
+
+private:
+  float clamp(float value) const
+  {
+    return (value > _out_max) ? _out_max : (value < _out_min) ? _out_min : value;
+  }
+
+  float _out_min;
+  float _out_max;
+  float _derivative_tau_s;
+  PidGains _gains = {};
+
+  float _integral = 0;
+  float _last_measurement = 0;
+  float _slope = 0;
+  float _output = 0;
+};
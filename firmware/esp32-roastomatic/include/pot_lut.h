@@ -0,0 +1,110 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+
+// Potentiometer linearization.
+// A pot is calibrated by recording the ADC counts at a handful of reference
+// dial positions. Those points are expanded once into a dense table, so the
+// hot path is one shift, one table read and an integer interpolation.
+
+const int POT_FULL_SCALE = 4095; // 12 bit position, same units as the PWM duty
+const int POT_REFERENCE_POINTS = 9;
+const int POT_TABLE_SHIFT = 4; // one table entry every 16 ADC counts
+const int POT_TABLE_SIZE = (4096 >> POT_TABLE_SHIFT) + 1;
+
+// Reference dial positions, in hundredths, that a calibration sweep visits.
+// 7.5 is the end stop: 270 of 360 degrees on a 0-10 dial.
+const int MAX_DIAL_HUNDREDTHS = 750;
+constexpr uint16_t POT_REFERENCE_DIAL[POT_REFERENCE_POINTS] = {0, 100, 200, 300, 400, 500, 600, 700, 750};
+
+// ADC counts at each reference position. The default is a straight line.
+struct PotCalibration
+{
+  uint16_t counts[POT_REFERENCE_POINTS];
+};
+
+constexpr PotCalibration linear_pot_calibration()
+{
+  PotCalibration calibration{};
+  for (int i = 0; i < POT_REFERENCE_POINTS; i++)
+  {
+    calibration.counts[i] = (uint32_t)POT_REFERENCE_DIAL[i] * POT_FULL_SCALE / MAX_DIAL_HUNDREDTHS;
+  }
+  return calibration;
+}
+
+// Usable calibrations rise strictly, otherwise interpolation would divide by zero
+constexpr bool pot_calibration_valid(const PotCalibration &calibration)
+{
+  for (int i = 1; i < POT_REFERENCE_POINTS; i++)
+  {
+    if (calibration.counts[i] <= calibration.counts[i - 1])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Position (0 to POT_FULL_SCALE) at every 16th ADC count
+struct PotTable
+{
+  uint16_t position[POT_TABLE_SIZE];
+};
+
+constexpr PotTable make_pot_table(const PotCalibration &calibration)
+{
+  PotTable table{};
+  int segment = 0;
+  for (int i = 0; i < POT_TABLE_SIZE; i++)
+  {
+    int32_t counts = i << POT_TABLE_SHIFT;
+    while (segment < POT_REFERENCE_POINTS - 2 && counts >= calibration.counts[segment + 1])
+    {
+      segment++;
+    }
+
+    int32_t low = calibration.counts[segment];
+    int32_t high = calibration.counts[segment + 1];
+    int32_t low_position = (int32_t)POT_REFERENCE_DIAL[segment] * POT_FULL_SCALE / MAX_DIAL_HUNDREDTHS;
+    int32_t high_position = (int32_t)POT_REFERENCE_DIAL[segment + 1] * POT_FULL_SCALE / MAX_DIAL_HUNDREDTHS;
+    int32_t position = low_position + (counts - low) * (high_position - low_position) / (high - low);
+
+    table.position[i] = (position < 0) ? 0 : (position > POT_FULL_SCALE) ? POT_FULL_SCALE : position;
+  }
+  return table;
+}
+
+constexpr PotTable DEFAULT_POT_TABLE = make_pot_table(linear_pot_calibration());
+
+// ADC counts to position, constant time and integer only
+inline uint16_t pot_position(const PotTable &table, uint16_t counts)
+{
+  uint32_t i = counts >> POT_TABLE_SHIFT;
+  int32_t fraction = counts & ((1 << POT_TABLE_SHIFT) - 1);
+  int32_t low = table.position[i];
+  int32_t high = table.position[i + 1];
+  return low + (((high - low) * fraction) >> POT_TABLE_SHIFT);
+}
@@ -0,0 +1,80 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <esp_adc/adc_continuous.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+
+// Fan and heat potentiometers sampled by the ADC in continuous (DMA) mode.
+// Each DMA frame is averaged per channel, then smoothed with a short moving
+// average, which together act as a two stage decimating filter. The work
+// happens in this object's own task, so readers only load an atomic.
+class PotSampler
+{
+public:
+  static const int NUM_POTS = 2;
+  static const uint32_t SAMPLE_HZ = 20000;  // conversions per second, all pots
+  static const uint32_t FRAME_BYTES = 1024; // 512 conversions, 256 per pot
+  static const int SMOOTH_LENGTH = 4;       // frames in the second stage
+  static const int NOISE_WINDOW = 256;      // outputs per noise figure, ~6.5s
+
+  explicit PotSampler(const int pins[NUM_POTS]);
+
+  void begin(int core, int priority);
+
+  // Latest filtered value in ADC counts
+  int value(int pot) const { return _value[pot].load(std::memory_order_relaxed); }
+
+  // Standard deviation in ADC counts over the last noise window, of the raw
+  // conversions within a frame and of the filtered output.
+  float raw_noise(int pot) const { return _raw_noise[pot]; }
+  float filtered_noise(int pot) const { return _filtered_noise[pot]; }
+
+private:
+  static bool on_frame(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *data, void *arg);
+  static void task(void *arg);
+  void process(const uint8_t *frame, uint32_t length);
+  void publish(int pot, int32_t decimated);
+
+  int _pins[NUM_POTS];
+  adc_channel_t _channels[NUM_POTS];
+  adc_continuous_handle_t _handle = NULL;
+  TaskHandle_t _task = NULL;
+
+  std::atomic<int> _value[NUM_POTS];
+
+  int32_t _smooth[NUM_POTS][SMOOTH_LENGTH] = {};
+  int32_t _smooth_sum[NUM_POTS] = {};
+  int _smooth_index = 0;
+
+  // Noise bookkeeping
+  int _noise_count = 0;
+  double _raw_variance_sum[NUM_POTS] = {};
+  double _filtered_sum[NUM_POTS] = {};
+  double _filtered_square_sum[NUM_POTS] = {};
+  float _raw_noise[NUM_POTS] = {};
+  float _filtered_noise[NUM_POTS] = {};
+};
@@ -0,0 +1,58 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Per-probe correction from the thermocouple's reading to true temperature.
+// The MAX6675 reads high and not quite linearly, so each probe gets a cubic
+// fit against a reference thermometer (software/python roastomatic.probe):
+//   true_f = c0 + c1 u + c2 u^2 + c3 u^3,  u = raw_f / 256
+// Scaling by 256 keeps every coefficient in a similar range, so they all fit
+// Q16 and the polynomial runs in integer math.
+// lag_tau_s is the probe's first order time constant, for recovering the
+// temperature around it from its reading and rate (0 for none).
+struct ProbeCalibration
+{
+  int32_t coefficients[4]; // Q16, lowest power first
+  float lag_tau_s;
+};
+
+const ProbeCalibration PROBE_IDENTITY = {{0, 256 << 16, 0, 0}, 0.0};
+
+inline float calibrate(const ProbeCalibration &calibration, float raw_f)
+{
+  if (isnan(raw_f))
+  {
+    return NAN;
+  }
+  int64_t u = llroundf(raw_f * 65536); // raw_f / 256 in Q24
+  int64_t sum = calibration.coefficients[3];
+  for (int i = 2; i >= 0; i--)
+  {
+    sum = ((sum * u) >> 24) + calibration.coefficients[i];
+  }
+  return sum / 65536.0f;
+}
@@ -0,0 +1,82 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+
+// Cycle counter profiling of each phase of the control and display loops.
+// Build with -DROASTOMATIC_PROFILE to enable. Without it the macros expand to
+// nothing and none of this is compiled in.
+
+enum ProfilePhase
+{
+  PHASE_POTS,
+  PHASE_THERMOCOUPLES,
+  PHASE_LOAD_CELL,
+  PHASE_PROGRAM,
+  PHASE_OUTPUTS,
+  PHASE_DISPLAY,
+  PHASE_DISPLAY_FLUSH,
+  PHASE_TELEMETRY,
+  NUM_PHASES,
+};
+
+#ifdef ROASTOMATIC_PROFILE
+
+#include <esp_cpu.h>
+
+// Power of two histogram of cycle counts: bucket i holds [2^i, 2^(i+1))
+const int PROFILE_BUCKETS = 32;
+
+struct PhaseProfile
+{
+  uint32_t count;
+  uint64_t total_cycles;
+  uint32_t max_cycles;
+  uint32_t buckets[PROFILE_BUCKETS];
+};
+
+extern PhaseProfile phase_profiles[NUM_PHASES];
+
+// Each phase is only ever recorded from one task, so no locking is needed.
+inline void profile_record(ProfilePhase phase, uint32_t cycles)
+{
+  PhaseProfile &p = phase_profiles[phase];
+  p.count++;
+  p.total_cycles += cycles;
+  p.max_cycles = (cycles > p.max_cycles) ? cycles : p.max_cycles;
+  p.buckets[(cycles > 0) ? 31 - __builtin_clz(cycles) : 0]++;
+}
+
+void profile_print();
+void profile_reset();
+
+#define PROFILE_BEGIN(phase) uint32_t _profile_##phase = esp_cpu_get_cycle_count()
+#define PROFILE_END(phase) profile_record(phase, esp_cpu_get_cycle_count() - _profile_##phase)
+
+#else
+
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+
+#endif
@@ -0,0 +1,151 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+
+#include "pid.h"
+
+// Relay feedback autotuner (Astrom-Hagglund).
+// The heater is switched between bias + amplitude and bias - amplitude each
+// time the measurement crosses the setpoint, with a little hysteresis for the
+// thermocouple's quantization. The loop settles into a limit cycle at the
+// roaster's ultimate period; its amplitude gives the ultimate gain
+// Ku = 4 d / (pi a). Gains come from the Tyreus-Luyben rules, which are gentler
+// than Ziegler-Nichols and suit a lag dominated thermal plant.
+class RelayAutotuner
+{
+public:
+  static const int CYCLES = 4; // the first one settles and isn't used
+
+  enum State
+  {
+    IDLE,
+    RUNNING,
+    DONE,
+    FAILED, // no steady oscillation before the timeout
+  };
+
+  void start(float setpoint, float bias, float amplitude, float hysteresis, float now_s, float timeout_s)
+  {
+    _setpoint = setpoint;
+    _bias = bias;
+    _amplitude = amplitude;
+    _hysteresis = hysteresis;
+    _timeout_s = now_s + timeout_s;
+    _high = true;
+    _cycles = 0;
+    _period_sum = 0;
+    _swing_sum = 0;
+    _peak = -INFINITY;
+    _trough = INFINITY;
+    _state = RUNNING;
+  }
+
+  // Returns the heater output to apply
+  float update(float measurement, float now_s)
+  {
+    if (_state != RUNNING)
+    {
+      return _bias;
+    }
+    if (now_s > _timeout_s)
+    {
+      _state = FAILED;
+      return _bias;
+    }
+
+    _peak = fmaxf(_peak, measurement);
+    _trough = fminf(_trough, measurement);
+
+    if (_high && measurement > _setpoint + _hysteresis)
+    {
+      _high = false;
+    }
+    else if (!_high && measurement < _setpoint - _hysteresis)
+    {
+      // One full cycle ends each time the heater comes back on
+      _high = true;
+      if (_cycles > 0)
+      {
+        _period_sum += now_s - _cycle_start_s;
+        _swing_sum += _peak - _trough;
+      }
+      _cycle_start_s = now_s;
+      _peak = -INFINITY;
+      _trough = INFINITY;
+      if (++_cycles > CYCLES)
+      {
+        finish();
+      }
+    }
+    return _high ? _bias + _amplitude : _bias - _amplitude;
+  }
+
+  State state() const { return _state; }
+  int cycles() const { return _cycles; }
+  float ultimate_gain() const { return _ultimate_gain; }
+  float ultimate_period_s() const { return _ultimate_period_s; }
+  const PidGains &gains() const { return _gains; }
+
+private:
+  void finish()
+  {
+    float swing = _swing_sum / CYCLES; // peak to peak
+    _ultimate_period_s = _period_sum / CYCLES;
+    // The hysteresis delays each switch; take it out of the amplitude
+    float a = sqrtf(fmaxf(swing * swing / 4 - _hysteresis * _hysteresis, 0));
+    if (a <= 0 || _ultimate_period_s <= 0)
+    {
+      _state = FAILED;
+      return;
+    }
+    _ultimate_gain = 4 * _amplitude / (M_PI * a);
+
+    float kp = _ultimate_gain / 2.2;
+    float ti = 2.2 * _ultimate_period_s;
+    float td = _ultimate_period_s / 6.3;
+    _gains = {kp, kp / ti, kp * td};
+    _state = DONE;
+  }
+
+  State _state = IDLE;
+  float _setpoint = 0;
+  float _bias = 0;
+  float _amplitude = 0;
+  float _hysteresis = 0;
+  float _timeout_s = 0;
+
+  bool _high = true;
+  int _cycles = 0;
+  float _cycle_start_s = 0;
+  float _period_sum = 0;
+  float _swing_sum = 0;
+  float _peak = 0;
+  float _trough = 0;
+
+  float _ultimate_gain = 0;
+  float _ultimate_period_s = 0;
+  PidGains _gains = {};
+};
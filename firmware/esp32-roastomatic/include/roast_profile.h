@@ -0,0 +1,170 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Target roast curves: bean temperature, and optionally fan, against roast time.
+// Stored in flash and sent over serial as the same little endian blob, a header
+// followed by num_points points, built by software/python roastomatic.profile.
+const uint32_t PROFILE_MAGIC = 0x46505252; // "RRPF"
+const uint8_t PROFILE_VERSION = 1;
+const uint8_t PROFILE_HAS_FAN = 0x01;
+const int MAX_PROFILE_POINTS = 64;
+const int PROFILE_NAME_LENGTH = 12;
+
+struct RoastProfileHeader
+{
+  uint32_t magic;
+  uint8_t version;
+  uint8_t flags;
+  uint16_t num_points;
+  char name[PROFILE_NAME_LENGTH]; // not necessarily terminated
+  uint16_t checksum;              // Fletcher-16 over the points
+  uint16_t reserved;
+};
+
+struct ProfilePoint
+{
+  uint16_t time_s;        // since the start of ROAST, strictly increasing
+  uint16_t bean_f_tenths; // tenths of a degree F
+  uint16_t fan_permille;  // ignored without PROFILE_HAS_FAN
+};
+
+struct RoastProfile
+{
+  RoastProfileHeader header;
+  ProfilePoint points[MAX_PROFILE_POINTS];
+};
+
+static_assert(sizeof(RoastProfileHeader) == 24, "profile header is a wire format");
+static_assert(sizeof(ProfilePoint) == 6, "profile point is a wire format");
+
+inline size_t profile_size(uint16_t num_points)
+{
+  return sizeof(RoastProfileHeader) + num_points * sizeof(ProfilePoint);
+}
+
+inline uint16_t profile_checksum(const uint8_t *data, size_t length)
+{
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (size_t i = 0; i < length; i++)
+  {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+// Copies a blob into profile if it is a complete, consistent profile
+inline bool profile_load(const uint8_t *data, size_t length, RoastProfile &profile)
+{
+  if (length < sizeof(RoastProfileHeader))
+  {
+    return false;
+  }
+  RoastProfileHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != PROFILE_MAGIC || header.version != PROFILE_VERSION ||
+      header.num_points < 2 || header.num_points > MAX_PROFILE_POINTS ||
+      length != profile_size(header.num_points))
+  {
+    return false;
+  }
+  const uint8_t *points = data + sizeof(header);
+  if (profile_checksum(points, length - sizeof(header)) != header.checksum)
+  {
+    return false;
+  }
+  memcpy(&profile, data, length);
+  for (int i = 1; i < header.num_points; i++)
+  {
+    if (profile.points[i].time_s <= profile.points[i - 1].time_s)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct ProfileSetpoint
+{
+  float bean_f;
+  float fan_fraction; // 0 to 1, negative when the profile has no fan curve
+  float bean_f_per_minute; // rate of rise along the curve, 0 off either end
+};
+
+// Linear interpolation along a profile.
+// The cursor remembers the segment it was last in, so as roast time moves
+// forward each call is a comparison or two instead of a search. Time going
+// backward (a restarted roast) starts the walk over from the beginning.
+// Before the first point and after the last, the end points hold.
+class ProfileCursor
+{
+public:
+  void attach(const RoastProfile *profile)
+  {
+    _profile = profile;
+    _index = 0;
+  }
+  const RoastProfile *profile() const { return _profile; }
+
+  ProfileSetpoint at(float time_s)
+  {
+    const ProfilePoint *points = _profile->points;
+    int last = _profile->header.num_points - 1;
+    if (time_s < points[_index].time_s)
+    {
+      _index = 0;
+    }
+    while (_index < last - 1 && time_s >= points[_index + 1].time_s)
+    {
+      _index++;
+    }
+
+    const ProfilePoint &a = points[_index];
+    const ProfilePoint &b = points[_index + 1];
+    float span_s = b.time_s - a.time_s;
+    float fraction = (time_s - a.time_s) / span_s;
+    bool inside = (fraction >= 0 && fraction <= 1);
+    fraction = (fraction < 0) ? 0 : (fraction > 1) ? 1 : fraction;
+
+    ProfileSetpoint setpoint;
+    setpoint.bean_f = (a.bean_f_tenths + fraction * (b.bean_f_tenths - a.bean_f_tenths)) / 10;
+    setpoint.bean_f_per_minute = inside ? (b.bean_f_tenths - a.bean_f_tenths) * 6 / span_s : 0;
+    setpoint.fan_fraction = -1;
+    if (_profile->header.flags & PROFILE_HAS_FAN)
+    {
+      setpoint.fan_fraction = (a.fan_permille + fraction * (b.fan_permille - a.fan_permille)) / 1000;
+    }
+    return setpoint;
+  }
+
+private:
+  const RoastProfile *_profile = nullptr;
+  int _index = 0;
+};
@@ -0,0 +1,98 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Bean temperature rate of rise from a least squares line over the last
+// WINDOW samples, taken at a fixed interval.
+// Samples are kept in hundredths of a degree as integers, so the running sums
+// are exact and each new sample updates them in O(1) with no drift, however
+// long the roast. The slope is causal; its lag is half the window.
+template <int WINDOW>
+class RorEstimator
+{
+public:
+  explicit RorEstimator(float sample_period_s) : _samples_per_minute(60.0 / sample_period_s) {}
+
+  void reset()
+  {
+    _count = 0;
+    _head = 0;
+    _sum = 0;
+    _weighted_sum = 0;
+  }
+
+  // NAN samples are skipped
+  void add(float temp_f)
+  {
+    if (isnan(temp_f))
+    {
+      return;
+    }
+    int32_t y = lroundf(temp_f * 100);
+    if (_count < WINDOW)
+    {
+      // Filling: the new sample lands at x = count
+      _weighted_sum += (int64_t)_count * y;
+      _sum += y;
+      _window[_count++] = y;
+      return;
+    }
+    // Full: every x moves down one and the oldest, at x = 0, drops out
+    int32_t oldest = _window[_head];
+    _weighted_sum += -(_sum - oldest) + (int64_t)(WINDOW - 1) * y;
+    _sum += y - oldest;
+    _window[_head] = y;
+    _head = (_head + 1) % WINDOW;
+  }
+
+  bool ready() const { return _count >= MIN_SAMPLES; }
+
+  // Degrees F per minute, NAN until there are enough samples
+  float f_per_minute() const
+  {
+    if (!ready())
+    {
+      return NAN;
+    }
+    int64_t n = _count;
+    int64_t sum_x = n * (n - 1) / 2;
+    int64_t sum_xx = (n - 1) * n * (2 * n - 1) / 6;
+    int64_t numerator = n * _weighted_sum - sum_x * _sum;
+    int64_t denominator = n * sum_xx - sum_x * sum_x;
+    return (float)numerator / denominator / 100 * _samples_per_minute;
+  }
+
+private:
+  static const int MIN_SAMPLES = (WINDOW < 8) ? WINDOW : 8;
+
+  float _samples_per_minute;
+  int32_t _window[WINDOW] = {};
+  int _count = 0;
+  int _head = 0; // oldest sample once full
+  int64_t _sum = 0;
+  int64_t _weighted_sum = 0; // sum of x * y, x = 0 for the oldest
+};
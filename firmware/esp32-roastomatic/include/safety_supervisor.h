@@ -0,0 +1,181 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <math.h>
+#include <stdint.h>
+
+// Heater interlock checked from a timer interrupt, independent of the tasks.
+// The control task reports what it sees every pass; the interrupt checks those
+// values and how long ago they came, and latches a trip on the first problem.
+// A control task that stops reporting trips it too, so a blocked task can't
+// leave the heater on. All shared state is 32 bit atomics, safe from an ISR.
+// Flash writes turn the cache off on both cores, stalling the control task
+// for longer than any useful heartbeat timeout. Every write is wrapped in
+// hold()/release(); see those.
+// The interrupt's path is integer only, as the FPU can't be used in an ISR,
+// and forced inline into the IRAM callback so none of it runs from flash.
+#define SAFETY_ISR_INLINE inline __attribute__((always_inline))
+
+class SafetySupervisor
+{
+public:
+  enum Trip : uint32_t
+  {
+    NONE,
+    OVER_TEMPERATURE,
+    THERMOCOUPLE_OPEN,
+    FAN_TOO_LOW, // heating without enough air
+    HEARTBEAT,   // control task stopped reporting
+  };
+
+  struct Limits
+  {
+    float max_bean_f;
+    float max_intake_f;
+    uint16_t min_fan_for_heat; // output counts
+    uint32_t heartbeat_timeout_us;
+  };
+
+  explicit SafetySupervisor(const Limits &limits)
+      : _limits(limits), _max_bean_tenths(tenths(limits.max_bean_f)),
+        _max_intake_tenths(tenths(limits.max_intake_f)) {}
+
+  // Control task, every pass. now_us wraps at 32 bits; only differences are used.
+  void report(uint32_t now_us, float bean_f, float intake_f, uint16_t heat, uint16_t fan)
+  {
+    _bean_tenths.store(tenths(bean_f), std::memory_order_relaxed);
+    _intake_tenths.store(tenths(intake_f), std::memory_order_relaxed);
+    _outputs.store(((uint32_t)heat << 16) | fan, std::memory_order_relaxed);
+    _report_us.store(now_us, std::memory_order_release);
+    _armed.store(true, std::memory_order_release);
+  }
+
+  // Timer interrupt. Returns the trip, which stays latched until reset().
+  SAFETY_ISR_INLINE Trip check(uint32_t now_us)
+  {
+    if (tripped() || !_armed.load(std::memory_order_acquire))
+    {
+      return reason();
+    }
+    uint32_t report_us = _report_us.load(std::memory_order_acquire);
+    uint32_t since_report_us = now_us - report_us;
+    Trip trip = evaluate();
+    uint32_t latency_us = since_report_us;
+    if (trip == NONE && _holds.load(std::memory_order_acquire) == 0 &&
+        since_report_us > _limits.heartbeat_timeout_us)
+    {
+      trip = HEARTBEAT;
+      latency_us = since_report_us - _limits.heartbeat_timeout_us;
+    }
+    if (trip != NONE)
+    {
+      // From the moment the fault was visible to the moment the heater is off
+      _latency_us.store(latency_us, std::memory_order_relaxed);
+      if (latency_us > _max_latency_us.load(std::memory_order_relaxed))
+      {
+        _max_latency_us.store(latency_us, std::memory_order_relaxed);
+      }
+      _trips.fetch_add(1, std::memory_order_relaxed);
+      _reason.store(trip, std::memory_order_release);
+    }
+    return trip;
+  }
+
+  // Any task, around a flash write. The heartbeat isn't checked until the
+  // matching release(), and its timeout starts again from there. The last
+  // reported temperatures and outputs still are.
+  void hold() { _holds.fetch_add(1, std::memory_order_acq_rel); }
+
+  void release(uint32_t now_us)
+  {
+    _report_us.store(now_us, std::memory_order_release);
+    _holds.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  // Any task. Only clears when the last report is healthy again.
+  bool reset()
+  {
+    if (evaluate() != NONE)
+    {
+      return false;
+    }
+    _reason.store(NONE, std::memory_order_release);
+    return true;
+  }
+
+  SAFETY_ISR_INLINE bool tripped() const { return reason() != NONE; }
+  SAFETY_ISR_INLINE Trip reason() const { return (Trip)_reason.load(std::memory_order_acquire); }
+  uint32_t latency_us() const { return _latency_us.load(std::memory_order_relaxed); }
+  uint32_t max_latency_us() const { return _max_latency_us.load(std::memory_order_relaxed); }
+  uint32_t trips() const { return _trips.load(std::memory_order_relaxed); }
+
+  static const char *name(Trip trip)
+  {
+    const char *names[] = {"ok", "over_temperature", "thermocouple_open", "fan_too_low", "heartbeat"};
+    return names[trip];
+  }
+
+private:
+  static const int32_t OPEN = INT32_MIN; // a NAN reading
+
+  static int32_t tenths(float temp_f) { return isnan(temp_f) ? OPEN : (int32_t)(temp_f * 10); }
+
+  SAFETY_ISR_INLINE Trip evaluate() const
+  {
+    int32_t bean = _bean_tenths.load(std::memory_order_relaxed);
+    int32_t intake = _intake_tenths.load(std::memory_order_relaxed);
+    uint32_t outputs = _outputs.load(std::memory_order_relaxed);
+    uint16_t heat = outputs >> 16;
+    uint16_t fan = outputs & 0xFFFF;
+    if (bean == OPEN || intake == OPEN)
+    {
+      return THERMOCOUPLE_OPEN;
+    }
+    if (bean > _max_bean_tenths || intake > _max_intake_tenths)
+    {
+      return OVER_TEMPERATURE;
+    }
+    if (heat > 0 && fan < _limits.min_fan_for_heat)
+    {
+      return FAN_TOO_LOW;
+    }
+    return NONE;
+  }
+
+  Limits _limits;
+  int32_t _max_bean_tenths;
+  int32_t _max_intake_tenths;
+  std::atomic<int32_t> _bean_tenths{0};
+  std::atomic<int32_t> _intake_tenths{0};
+  std::atomic<uint32_t> _outputs{0};
+  std::atomic<uint32_t> _report_us{0};
+  std::atomic<bool> _armed{false}; // from the first report
+  std::atomic<uint32_t> _holds{0};
+  std::atomic<uint32_t> _reason{NONE};
+  std::atomic<uint32_t> _latency_us{0};
+  std::atomic<uint32_t> _max_latency_us{0};
+  std::atomic<uint32_t> _trips{0};
+};
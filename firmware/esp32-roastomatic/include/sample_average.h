@@ -0,0 +1,55 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+
+// Running mean of load cell samples, fed one sample at a time so tare and
+// calibration can be spread across control passes instead of blocking.
+struct SampleAverage
+{
+  int target = 0;
+  int count = 0;
+  int64_t sum = 0;
+
+  void start(int n)
+  {
+    target = n;
+    count = 0;
+    sum = 0;
+  }
+
+  // Returns true once the target number of samples is in
+  bool add(int32_t sample)
+  {
+    if (count < target)
+    {
+      sum += sample;
+      count++;
+    }
+    return done();
+  }
+
+  bool done() const { return target > 0 && count >= target; }
+  int32_t mean() const { return (count > 0) ? sum / count : 0; }
+};
@@ -0,0 +1,135 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*JobFunction)();
+typedef int64_t (*ClockFunction)(); // microseconds, never wraps
+
+// One row of a Scheduler's job table
+struct Job
+{
+  const char *name;
+  JobFunction run;
+  uint32_t period_us;
+  uint8_t priority;     // 0 runs first when several jobs are due at once
+  uint32_t deadline_us; // must finish this long after its release time
+
+  // Bookkeeping, filled in by the scheduler
+  int64_t release_us;
+  uint32_t runs;
+  uint32_t overruns;  // finished past the deadline
+  uint32_t skipped;   // whole periods lost because the job ran late
+  uint32_t max_run_us;
+};
+
+// Cooperative, table-driven rate scheduler on a 64 bit microsecond clock.
+// Jobs never preempt each other; when several are due the highest priority
+// runs first, and a job that falls behind drops whole periods instead of
+// running back to back, so it can't starve the rest. Per-job counters show
+// which job is eating the budget.
+class Scheduler
+{
+public:
+  Scheduler(Job *jobs, int num_jobs, ClockFunction clock)
+      : _jobs(jobs), _num_jobs(num_jobs), _clock(clock) {}
+
+  void start()
+  {
+    int64_t now_us = _clock();
+    for (int i = 0; i < _num_jobs; i++)
+    {
+      _jobs[i].release_us = now_us;
+      _jobs[i].runs = 0;
+      _jobs[i].overruns = 0;
+      _jobs[i].skipped = 0;
+      _jobs[i].max_run_us = 0;
+    }
+  }
+
+  // Runs every job that is due. Returns microseconds until the next release.
+  int64_t run_due()
+  {
+    for (;;)
+    {
+      int64_t now_us = _clock();
+      Job *next = NULL;
+      for (int i = 0; i < _num_jobs; i++)
+      {
+        Job *job = &_jobs[i];
+        if (job->release_us <= now_us && (next == NULL || job->priority < next->priority))
+        {
+          next = job;
+        }
+      }
+      if (next == NULL)
+      {
+        return until_next(now_us);
+      }
+      run(next, now_us);
+    }
+  }
+
+  const Job &job(int i) const { return _jobs[i]; }
+  int num_jobs() const { return _num_jobs; }
+
+private:
+  void run(Job *job, int64_t start_us)
+  {
+    job->run();
+    int64_t end_us = _clock();
+
+    uint32_t run_us = end_us - start_us;
+    job->max_run_us = (run_us > job->max_run_us) ? run_us : job->max_run_us;
+    job->runs++;
+    if (end_us - job->release_us > job->deadline_us)
+    {
+      job->overruns++;
+    }
+
+    job->release_us += job->period_us;
+    if (job->release_us <= end_us)
+    {
+      // Catch up on the grid instead of running again immediately
+      int64_t behind = (end_us - job->release_us) / job->period_us + 1;
+      job->skipped += behind;
+      job->release_us += behind * job->period_us;
+    }
+  }
+
+  int64_t until_next(int64_t now_us) const
+  {
+    int64_t next_us = INT64_MAX;
+    for (int i = 0; i < _num_jobs; i++)
+    {
+      next_us = (_jobs[i].release_us < next_us) ? _jobs[i].release_us : next_us;
+    }
+    return next_us - now_us;
+  }
+
+  Job *_jobs;
+  int _num_jobs;
+  ClockFunction _clock;
+};
@@ -0,0 +1,67 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <driver/gptimer.h>
+#include <stdint.h>
+
+#include "heater_modulator.h"
+
+// Zero-crossing SSR driven one mains half-cycle at a time.
+// A general purpose timer fires once per half-cycle and sets the SSR input for
+// the next one from the HeaterModulator. A zero-crossing SSR only switches at
+// the crossing, so the timer doesn't need to be phase locked to the mains;
+// it only needs to run at the mains rate so each decision lands in its own
+// half-cycle.
+class SsrHeater
+{
+public:
+  SsrHeater(int pin, uint16_t full_scale);
+
+  void begin(uint32_t mains_hz);
+  void set_mains_frequency(uint32_t mains_hz);
+  uint32_t mains_frequency() const { return _mains_hz; }
+
+  void set_duty(uint16_t duty) { _modulator.set_duty(duty); }
+  uint16_t duty() const { return _modulator.duty(); }
+
+  // Any context, including interrupts. Off at once and for every half-cycle
+  // until the trip is cleared, whatever the duty.
+  void trip();
+  void clear_trip() { _tripped.store(false); }
+  bool tripped() const { return _tripped.load(); }
+
+  uint32_t half_cycles() const { return _modulator.half_cycles(); }
+  uint32_t half_cycles_on() const { return _modulator.half_cycles_on(); }
+
+private:
+  static bool on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *event, void *arg);
+
+  int _pin;
+  uint32_t _mains_hz = 0;
+  HeaterModulator _modulator;
+  gptimer_handle_t _timer = nullptr;
+  std::atomic<bool> _tripped{false};
+};
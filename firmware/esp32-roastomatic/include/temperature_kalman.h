@@ -0,0 +1,130 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+
+// Noise model for a thermocouple channel.
+// The measurement noise grows with temperature: a hot probe in moving beans
+// and air sees more of it than one sitting in still room air.
+struct KalmanNoise
+{
+  float rate_walk;   // process noise on the rate, (F/s)^2 per s
+  float sigma_f;     // measurement standard deviation at base_f
+  float sigma_per_f; // its growth per degree above base_f
+  float base_f;
+};
+
+// Causal Kalman filter for a temperature and its rate of change.
+// The state is [temperature, rate]. Between readings the temperature moves at
+// the rate, and the rate either wanders (no model) or relaxes toward the rate
+// a thermal model expects, e.g. Newton heating toward the air. Everything is
+// a 2x2 with a scalar measurement, a few dozen flops per reading.
+// A NAN reading is an open probe and clears the estimate.
+class TemperatureKalman
+{
+public:
+  TemperatureKalman(const KalmanNoise &noise, float rate_tau_s)
+      : _noise(noise), _rate_tau_s(rate_tau_s) {}
+
+  void reset()
+  {
+    _temp_f = NAN;
+    _rate = 0;
+  }
+
+  // dt_s is the time since the last reading. model_rate is in F/s, NAN if the
+  // model has nothing to say.
+  void update(float measured_f, float dt_s, float model_rate = NAN)
+  {
+    if (isnan(measured_f))
+    {
+      reset();
+      return;
+    }
+    float r = measurement_variance(measured_f);
+    if (isnan(_temp_f))
+    {
+      _temp_f = measured_f;
+      _rate = isnan(model_rate) ? 0 : model_rate;
+      _p00 = r;
+      _p01 = 0;
+      _p11 = INITIAL_RATE_VARIANCE;
+      _innovation_f = 0;
+      return;
+    }
+
+    // Predict. With a model the rate relaxes by a toward it.
+    float a = 0;
+    _temp_f += _rate * dt_s;
+    if (!isnan(model_rate))
+    {
+      a = dt_s / (_rate_tau_s + dt_s);
+      _rate += a * (model_rate - _rate);
+    }
+    float b = 1 - a;
+    float q = _noise.rate_walk;
+    float p00 = _p00 + 2 * dt_s * _p01 + dt_s * dt_s * _p11 + q * dt_s * dt_s * dt_s / 3;
+    float p01 = b * (_p01 + dt_s * _p11) + q * dt_s * dt_s / 2;
+    float p11 = b * b * _p11 + q * dt_s;
+
+    // Correct
+    float s = p00 + r;
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    _innovation_f = measured_f - _temp_f;
+    _temp_f += k0 * _innovation_f;
+    _rate += k1 * _innovation_f;
+    _p00 = (1 - k0) * p00;
+    _p01 = (1 - k0) * p01;
+    _p11 = p11 - k1 * p01;
+  }
+
+  bool ready() const { return !isnan(_temp_f); }
+  float temperature_f() const { return _temp_f; }
+  float rate_f_per_minute() const { return ready() ? _rate * 60 : NAN; }
+  float temperature_sigma_f() const { return ready() ? sqrtf(_p00) : NAN; }
+  float innovation_f() const { return _innovation_f; } // last reading minus prediction
+
+  // Undo a first order probe lag: a probe with time constant tau reading T
+  // rising at dT/dt sits in T + tau dT/dt. Leads the estimate by about tau.
+  float leading_f(float probe_tau_s) const { return _temp_f + probe_tau_s * _rate; }
+
+  float measurement_variance(float temp_f) const
+  {
+    float above = temp_f - _noise.base_f;
+    float sigma = _noise.sigma_f + _noise.sigma_per_f * (above > 0 ? above : 0);
+    return sigma * sigma;
+  }
+
+private:
+  static constexpr float INITIAL_RATE_VARIANCE = 1.0; // (F/s)^2
+
+  KalmanNoise _noise;
+  float _rate_tau_s;
+  float _temp_f = NAN;
+  float _rate = 0; // F/s
+  float _p00 = 0, _p01 = 0, _p11 = 0;
+  float _innovation_f = 0;
+};
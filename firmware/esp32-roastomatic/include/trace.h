@@ -0,0 +1,101 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>
+
+// Fixed-size binary trace of timestamped begin/end/instant events.
+// Records go into a RAM ring that the host drains over serial with the
+// "trace" command (software/python/src/roastomatic/trace.py), which turns it
+// into a Chrome/Perfetto trace. Build with -DROASTOMATIC_TRACE to enable.
+
+// Keep in step with TRACE_EVENT_NAMES in trace.cpp
+enum TraceEvent
+{
+  TRACE_THERMOCOUPLES,
+  TRACE_LOAD_CELL,
+  TRACE_OUTPUTS,
+  TRACE_DISPLAY_FLUSH,
+  TRACE_TELEMETRY,
+  TRACE_STATE,
+  NUM_TRACE_EVENTS,
+};
+
+#ifdef ROASTOMATIC_TRACE
+
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+struct TraceRecord
+{
+  uint32_t time_us; // low 32 bits of esp_timer, the host unwraps it
+  uint8_t event;
+  uint8_t phase; // 'B', 'E' or 'i'
+  uint8_t core;
+  uint8_t arg;
+};
+
+const uint32_t TRACE_RECORDS = 4096; // 32kB, about 10s of a busy roast between pulls
+
+extern TraceRecord trace_ring[TRACE_RECORDS];
+extern std::atomic<uint32_t> trace_head;
+
+// Any task on either core may record. Claiming a slot is one atomic add.
+inline void trace_record(TraceEvent event, char phase, uint8_t arg, int64_t time_us)
+{
+  uint32_t index = trace_head.fetch_add(1, std::memory_order_relaxed);
+  TraceRecord &r = trace_ring[index & (TRACE_RECORDS - 1)];
+  r.time_us = time_us;
+  r.event = event;
+  r.phase = phase;
+  r.core = xPortGetCoreID();
+  r.arg = arg;
+}
+
+// Starts sending everything recorded since the last pull to Serial
+void trace_request();
+// Sends the next few lines of a pull, call it every command pass
+void trace_poll();
+
+#define TRACE_BEGIN(event) trace_record(event, 'B', 0, esp_timer_get_time())
+#define TRACE_END(event) trace_record(event, 'E', 0, esp_timer_get_time())
+#define TRACE_INSTANT(event, arg) trace_record(event, 'i', arg, esp_timer_get_time())
+// For work that is only worth tracing once it turns out something happened
+#define TRACE_MARK(name) int64_t name = esp_timer_get_time()
+#define TRACE_SPAN(event, begin_us)                      \
+  do                                                     \
+  {                                                      \
+    trace_record(event, 'B', 0, begin_us);               \
+    trace_record(event, 'E', 0, esp_timer_get_time());   \
+  } while (0)
+
+#else
+
+#define TRACE_BEGIN(event)
+#define TRACE_END(event)
+#define TRACE_INSTANT(event, arg)
+#define TRACE_MARK(name)
+#define TRACE_SPAN(event, begin_us)
+
+#endif
@@ -0,0 +1,63 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single writer / single reader snapshot.
+// The writer fills back() and calls publish(). The reader calls read() and
+// always gets the newest complete copy. Neither side ever waits on the other.
+template <typename T>
+class TripleBuffer
+{
+public:
+  // Writer side
+  T &back() { return _buffers[_back]; }
+
+  void publish()
+  {
+    uint8_t previous = _middle.exchange(_back | DIRTY, std::memory_order_acq_rel);
+    _back = previous & INDEX_MASK;
+  }
+
+  // Reader side
+  const T &read()
+  {
+    if (_middle.load(std::memory_order_acquire) & DIRTY)
+    {
+      uint8_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+      _front = previous & INDEX_MASK;
+    }
+    return _buffers[_front];
+  }
+
+private:
+  static const uint8_t INDEX_MASK = 0x03;
+  static const uint8_t DIRTY = 0x04;
+
+  T _buffers[3] = {};
+  std::atomic<uint8_t> _middle{1};
+  uint8_t _back = 0;  // only touched by the writer
+  uint8_t _front = 2; // only touched by the reader
+};
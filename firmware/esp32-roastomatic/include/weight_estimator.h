@@ -0,0 +1,168 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <math.h>
+
+// How the load cell's zero moves as the popper heats it, in counts, against
+// the intake temperature. Fit from logged preheat runs, where the pan is
+// empty, with software/python roastomatic.weight.
+struct LoadCellDrift
+{
+  float counts_per_f;
+  float counts_per_f2;
+  float reference_f; // where the terms are zero
+};
+
+struct WeightNoise
+{
+  float reading_counts; // standard deviation of one conversion
+  float zero_walk;      // drift the temperature terms miss, counts^2 per s
+  float mass_walk;      // how fast the charge can change, g^2 per s
+};
+
+// Load cell weight with its zero tracked through the roast.
+// The zero is base + drift(intake temperature). While the pan is known to be
+// empty, zero() refines the base with a scalar Kalman update. Once it's
+// loaded the base can't be seen, so only the temperature terms move it and
+// its variance grows by the walk. The mass is a second scalar filter over
+// (counts - zero) / scale. interval_g() covers both, so it widens the longer
+// the roast goes since the last zero.
+// Until zeroed the base is 0, and until calibrated the scale is 1, so grams
+// are the counts less the modelled drift, through the mass filter. Fit the
+// drift from logged raw counts, not grams.
+class WeightEstimator
+{
+public:
+  WeightEstimator(const LoadCellDrift &drift, const WeightNoise &noise)
+      : _drift(drift), _noise(noise), _intake_f(drift.reference_f) {}
+
+  void set_drift(const LoadCellDrift &drift) { _drift = drift; }
+  const LoadCellDrift &drift() const { return _drift; }
+  void set_noise(const WeightNoise &noise) { _noise = noise; }
+
+  void reset()
+  {
+    _base = 0;
+    _base_variance = INFINITY;
+    _counts_per_g = 1;
+    _grams = NAN;
+    _intake_f = _drift.reference_f;
+  }
+
+  // An empty pan reading. Returns false, leaving the zero alone, for one too
+  // far from it to be the empty pan.
+  bool zero(float counts, float intake_f, float dt_s)
+  {
+    track(intake_f);
+    float r = _noise.reading_counts * _noise.reading_counts;
+    if (isinf(_base_variance))
+    {
+      _base = counts - drift_counts();
+      _base_variance = r;
+      return true;
+    }
+    float p = _base_variance + _noise.zero_walk * dt_s;
+    float innovation = counts - zero_counts();
+    if (innovation * innovation > ZERO_GATE * ZERO_GATE * (p + r))
+    {
+      _base_variance = p;
+      return false;
+    }
+    float k = p / (p + r);
+    _base += k * innovation;
+    _base_variance = (1 - k) * p;
+    return true;
+  }
+
+  // A known mass on the pan sets the scale
+  void calibrate(float counts, float grams, float intake_f)
+  {
+    track(intake_f);
+    _counts_per_g = (counts - zero_counts()) / grams;
+    _grams = grams;
+    _grams_variance = 0;
+  }
+
+  // Every reading, loaded or not
+  void weigh(float counts, float intake_f, float dt_s)
+  {
+    track(intake_f);
+    if (!isinf(_base_variance))
+    {
+      _base_variance += _noise.zero_walk * dt_s;
+    }
+    float measured_g = (counts - zero_counts()) / _counts_per_g;
+    float r = _noise.reading_counts / _counts_per_g;
+    r *= r;
+    if (isnan(_grams))
+    {
+      _grams = measured_g;
+      _grams_variance = r;
+      return;
+    }
+    float p = _grams_variance + _noise.mass_walk * dt_s;
+    float k = p / (p + r);
+    _grams += k * (measured_g - _grams);
+    _grams_variance = (1 - k) * p;
+  }
+
+  float grams() const { return _grams; }
+
+  // Half width of the 95% interval on grams()
+  float interval_g() const
+  {
+    float zero_g = isinf(_base_variance) ? 0 : _base_variance / (_counts_per_g * _counts_per_g);
+    return 1.96f * sqrtf(_grams_variance + zero_g);
+  }
+
+  bool zeroed() const { return !isinf(_base_variance); }
+  float counts_per_g() const { return _counts_per_g; }
+
+  // At the last intake temperature seen; an open probe holds it
+  float zero_counts() const { return _base + drift_counts(); }
+
+private:
+  static constexpr float ZERO_GATE = 5.0; // standard deviations
+
+  void track(float intake_f)
+  {
+    _intake_f = isnan(intake_f) ? _intake_f : intake_f;
+  }
+
+  float drift_counts() const
+  {
+    float d = _intake_f - _drift.reference_f;
+    return d * (_drift.counts_per_f + d * _drift.counts_per_f2);
+  }
+
+  LoadCellDrift _drift;
+  WeightNoise _noise;
+  float _base = 0;
+  float _base_variance = INFINITY;
+  float _counts_per_g = 1;
+  float _grams = NAN;
+  float _grams_variance = 0;
+  float _intake_f;
+};
@@ -0,0 +1,110 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "hx711_reader.h"
+
+#include <esp_attr.h>
+#include <esp_rom_sys.h>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+
+// 24 data bits plus one extra pulse selects channel A, gain 128 for the next conversion
+const int HX711_DATA_BITS = 24;
+const int HX711_GAIN_PULSES = 1;
+
+Hx711Reader::Hx711Reader(int dt_pin, int sck_pin)
+    : _dt_pin(dt_pin), _sck_pin(sck_pin) {}
+
+void Hx711Reader::begin()
+{
+  if (_attached)
+  {
+    return;
+  }
+  pinMode(_dt_pin, INPUT);
+  pinMode(_sck_pin, OUTPUT);
+  digitalWrite(_sck_pin, LOW); // SCK high for more than 60us powers the chip down
+  attachInterruptArg(digitalPinToInterrupt(_dt_pin), isr, this, FALLING);
+  _attached = true;
+}
+
+void Hx711Reader::end()
+{
+  if (!_attached)
+  {
+    return;
+  }
+  detachInterrupt(digitalPinToInterrupt(_dt_pin));
+  _attached = false;
+}
+
+// Both pins are below 32, so they live in the low GPIO registers.
+void IRAM_ATTR Hx711Reader::isr(void *arg)
+{
+  Hx711Reader *self = (Hx711Reader *)arg;
+  uint32_t dt_mask = 1UL << self->_dt_pin;
+  uint32_t sck_mask = 1UL << self->_sck_pin;
+
+  // Data bits toggling DT while we clock them out queue another falling edge.
+  // By the time that fires DT is back high, so it's ignored here.
+  if (REG_READ(GPIO_IN_REG) & dt_mask)
+  {
+    return;
+  }
+
+  int64_t time_us = esp_timer_get_time();
+  uint32_t value = 0;
+  for (int i = 0; i < HX711_DATA_BITS + HX711_GAIN_PULSES; i++)
+  {
+    REG_WRITE(GPIO_OUT_W1TS_REG, sck_mask);
+    esp_rom_delay_us(1);
+    if (i < HX711_DATA_BITS)
+    {
+      value = (value << 1) | ((REG_READ(GPIO_IN_REG) & dt_mask) ? 1 : 0);
+    }
+    REG_WRITE(GPIO_OUT_W1TC_REG, sck_mask);
+    esp_rom_delay_us(1);
+  }
+
+  // Sign extend the 24 bit two's complement value
+  int32_t raw = (value & 0x800000) ? (int32_t)(value | 0xFF000000) : (int32_t)value;
+
+  if (self->_samples.push({raw, time_us}))
+  {
+    self->_captured++;
+  }
+  else
+  {
+    self->_dropped++;
+  }
+}
+
+bool Hx711Reader::pop(Hx711Sample &sample)
+{
+  if (!_samples.pop(sample))
+  {
+    return false;
+  }
+  // 24 bit counts are exact in a float
+  sample.raw = lroundf(_spikes.filter(sample.raw));
+  return true;
+}
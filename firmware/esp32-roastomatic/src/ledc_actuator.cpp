@@ -0,0 +1,114 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "ledc_actuator.h"
+
+#include <esp_err.h>
+
+LedcActuator::LedcActuator(ledc_mode_t mode, ledc_channel_t channel, uint32_t quantum,
+                           uint32_t slew_per_s, bool fade)
+    : _mode(mode), _channel(channel), _quantum(quantum ? quantum : 1),
+      _slew_per_s(slew_per_s), _fade(fade) {}
+
+void LedcActuator::begin()
+{
+  static bool fade_installed = false;
+  if (_fade && !fade_installed)
+  {
+    // One fade service covers every channel
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+    fade_installed = true;
+  }
+  _duty = ledc_get_duty(_mode, _channel);
+  _level = _duty;
+}
+
+// Move to the nearest step only once the input has left the current step by a
+// whole quantum, so a value sitting on a boundary doesn't toggle.
+uint32_t LedcActuator::quantize(uint32_t duty)
+{
+  uint32_t distance = (duty > _level) ? duty - _level : _level - duty;
+  if (distance >= _quantum)
+  {
+    _level = ((duty + _quantum / 2) / _quantum) * _quantum;
+  }
+  return _level;
+}
+
+bool LedcActuator::write(uint32_t duty, int64_t now_us)
+{
+  if (now_us - _window_start_us >= RATE_WINDOW_US)
+  {
+    _writes_per_second = _window_writes;
+    _window_writes = 0;
+    _window_start_us = now_us;
+  }
+  int64_t elapsed_us = now_us - _last_us;
+  _last_us = now_us;
+
+  uint32_t target = quantize(duty);
+  if (target == _duty || (_fade && now_us < _fade_end_us))
+  {
+    _coalesced++;
+    return false;
+  }
+
+  uint32_t step = (target > _duty) ? target - _duty : _duty - target;
+  if (_fade)
+  {
+    // The hardware ramps the whole step at the slew rate
+    int fade_ms = _slew_per_s ? (int)((uint64_t)step * 1000 / _slew_per_s) : 0;
+    if (fade_ms > 0)
+    {
+      ledc_set_fade_with_time(_mode, _channel, target, fade_ms);
+      ledc_fade_start(_mode, _channel, LEDC_FADE_NO_WAIT);
+      _fade_end_us = now_us + (int64_t)fade_ms * 1000;
+    }
+    else
+    {
+      ledc_set_duty(_mode, _channel, target);
+      ledc_update_duty(_mode, _channel);
+    }
+  }
+  else
+  {
+    if (_slew_per_s)
+    {
+      uint64_t max_step = (uint64_t)_slew_per_s * elapsed_us / 1000000;
+      if (max_step < 1)
+      {
+        max_step = 1;
+      }
+      if (step > max_step)
+      {
+        target = (target > _duty) ? _duty + max_step : _duty - max_step;
+      }
+    }
+    ledc_set_duty(_mode, _channel, target);
+    ledc_update_duty(_mode, _channel);
+  }
+  _duty = target;
+  _writes++;
+  _window_writes++;
+  return true;
+}
@@ -21,26 +21,57 @@
 // SOFTWARE.
 
 // Standard libraries
+#include <driver/gptimer.h>
 #include <driver/ledc.h> // PWM library.  Works with 3.0.7
 #include "esp_err.h"
+#include <esp_rom_sys.h>
+#include <esp_timer.h>
+#include <math.h>
 #include <Wire.h>
+#include <atomic>
+#include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <Preferences.h> // NVS
 
 // Third-party libraries
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
-#include <max6675.h> // Thermocouple amplifier library
-#include <HX711.h>   // Load Cell amplifier Library
 
 // Local libraries
 #include "button.h"
-
-// SSR Heater Clock setup for Pulse Width Modulation
-#define HEAT_MODE LEDC_LOW_SPEED_MODE
-#define HEAT_FREQUENCY 1
-#define HEAT_TIMER LEDC_TIMER_0
-#define HEAT_CHANNEL LEDC_CHANNEL_0
-#define HEAT_DUTY_RES LEDC_TIMER_12_BIT
+#include "cusum.h"
+#include "decimator.h"
+#include "drop_predictor.h"
+#include "hampel_filter.h"
+#include "hx711_reader.h"
+#include "jitter_stats.h"
+#include "ledc_actuator.h"
+#include "loop_stats.h"
+#include "max6675_bus.h"
+#include "mpc.h"
+#include "pid.h"
+#include "pot_lut.h"
+#include "pot_sampler.h"
+#include "probe_calibration.h"
+#include "profiler.h"
+#include "relay_autotuner.h"
+#include "ror_estimator.h"
+#include "roast_profile.h"
+#include "safety_supervisor.h"
+#include "sample_average.h"
+#include "scheduler.h"
+#include "ssr_heater.h"
+#include "temperature_kalman.h"
+#include "trace.h"
+#include "triple_buffer.h"
+#include "weight_estimator.h"
+
+// SSR Heater, switched per mains half-cycle
+const uint32_t DEFAULT_MAINS_FREQUENCY = 60; // Hz. Set with the "mains" command.
+const char *HEATER_NVS_NAMESPACE = "heater";
 
 // TIP120 Fan Clock setup for Pulse Width Modulation
 #define FAN_MODE LEDC_LOW_SPEED_MODE
@@ -49,6 +80,10 @@
 #define FAN_CHANNEL LEDC_CHANNEL_1
 #define FAN_DUTY_RES LEDC_TIMER_12_BIT
 
+// Fan output stage. A quantum of 16 counts is 0.4% duty, well above pot noise.
+const uint32_t FAN_QUANTUM = 16;
+const uint32_t FAN_SLEW_PER_S = 2048; // Half scale per second, faded in hardware
+
 // OLED display width and height, in pixels
 const int SCREEN_WIDTH = 128;
 const int SCREEN_HEIGHT = 64;
@@ -57,32 +92,32 @@ const int OLED_RESET = -1;
 // I2C address for the OLED display
 #define OLED_ADDRESS 0x3C
 
-// The potentiometers will turn 270 degrees
-// TODO: The resistance isn't linear.
-const int ADC_BIT_DEPTH = 12;
-const float MAX_DIAL = (270.0 / 360.0) * 10.0;
-const int MAX_POT_VALUE = (1 << ADC_BIT_DEPTH) - 1;
+// The potentiometers will turn 270 degrees. The resistance isn't linear, so
+// ADC counts go through a lookup table (pot_lut.h) calibrated per pot.
+const char *POT_NVS_NAMESPACE = "pots";
+const char *POT_NVS_KEYS[] = {"fan", "heat"};
 
 // Only sample the thermocouples every 250ms
 const int MIN_TEMP_SAMPLE_RATE = 250;
-
-// Modes for HX711
-struct Hx711Mode
-{
-  char text[22];
-  void (HX711::*mode)();
+#define THERMOCOUPLE_HOST SPI3_HOST // VSPI
+
+// Load cell decimation. The HX711 runs at 80 samples per second (RATE pin
+// high); every conversion goes through one of these to the weight. Pick with
+// "weight filter <n>", after comparing them in test_load_cell.
+const float LOAD_CELL_SPS = 80.0;
+const DecimatorSettings DECIMATOR_SETTINGS[] = {
+    // name, CIC order, CIC decimation, half band
+    {"box/4", 1, 4, false},      // 20 SPS
+    {"cic3/4", 3, 4, false},     // 20 SPS
+    {"cic3/8", 3, 8, false},     // 10 SPS
+    {"cic3/4+hb", 3, 4, true},   // 10 SPS
+    {"cic3/8+hb", 3, 8, true},   // 5 SPS
+    {"cic4/16+hb", 4, 16, true}, // 2.5 SPS
 };
+const int N_DECIMATOR_SETTINGS = sizeof(DECIMATOR_SETTINGS) / sizeof(DECIMATOR_SETTINGS[0]);
+const int DEFAULT_DECIMATOR_SETTING = 3;
 
-const Hx711Mode HX711_MODES[] = {
-    {"Average  ", &HX711::set_average_mode},
-    {"Median   ", &HX711::set_median_mode},
-    {"Med. Avg.", &HX711::set_medavg_mode},
-    {"Run. Avg.", &HX711::set_runavg_mode},
-    {"Raw      ", &HX711::set_raw_mode},
-};
-
-const int MIN_LOAD_CELL_SAMPLE_RATE = 100;
-const float START_SCALE = 420.52;
+const float START_SCALE = 420.52; // counts per gram, nominal
 
 // manual roast
 const int N_WEIGHT_SAMPLES = 15;           // Number of samples to be taken for tare and calibrate scale
@@ -90,8 +125,108 @@ const float ROAST_WEIGHT_GRAMS = 90.1;     // Will be used to calibrate % drop
 const float MIN_TEMP_FOR_PREHEAT = 325.0;  // Reach this temperature to trigger the TARE state.
 const float MAX_BEAN_TEMP_FOR_DONE = 80.0; // dropping  below this threshold will trigger DONE state
 const float MAX_HEAT_DUTY_FOR_DROP = 10;   // dropping below this threshold will trigger DROP state
-const int MIN_SERIAL_PRINT_RATE = 250;     // milliseconds between serial writes
-const int MIN_DISPLAY_RATE = 1000 / 60;    // 60Hz display update rate
+
+// Charge detection in LOAD. A CUSUM on the load, in grams at START_SCALE as
+// the pan isn't calibrated yet, catches half a charge a few outputs after it
+// starts to pour and dates it from where the step began. The bean probe
+// dipping below its filter's prediction corroborates it.
+const float CHARGE_MIN_G = 0.5 * ROAST_WEIGHT_GRAMS;
+const float CHARGE_CUSUM_DRIFT_G = 0.5 * CHARGE_MIN_G; // per decimated output
+const float CHARGE_CUSUM_THRESHOLD_G = CHARGE_MIN_G;
+const float BEAN_DIP_DRIFT_F = 1.0; // per reading, below the prediction
+const float BEAN_DIP_THRESHOLD_F = 6.0;
+const int BEAN_DIP_WINDOW_MS = 10000; // after the charge, to give up on the dip
+const int CHARGE_SETTLE_MS = 2000;    // before calibrating on the charge
+
+// Weight. The load cell's zero drifts as the popper heats it; the drift
+// against intake temperature is fit with software/python roastomatic.weight.
+const LoadCellDrift DEFAULT_LOAD_CELL_DRIFT = {0.0, 0.0, 70.0};
+const WeightNoise WEIGHT_NOISE = {200.0, 50.0, 2.5e-3}; // per conversion counts, counts^2/s, g^2/s
+const char *LOAD_CELL_NVS_NAMESPACE = "load_cell";
+
+// Drop prediction. The countdown is to the sooner of the weight loss and the
+// bean temperature set with the drop command.
+const DropTargets DEFAULT_DROP_TARGETS = {15.0, 440.0}; // percent, F
+const int DROP_TREND_WINDOW = 60;                       // samples in the rate fits
+const float DROP_TREND_PERIOD_S = 1.0;
+const char *DROP_NVS_NAMESPACE = "drop";
+
+// Automatic heat. In auto the heat dial sets the bean temperature setpoint.
+const float MIN_SETPOINT_F = 200.0;
+const float MAX_SETPOINT_F = 480.0;
+const float SETPOINT_RAMP_F_PER_S = 1.0;                  // how fast the setpoint follows the dial
+const uint32_t PID_PERIOD_US = MIN_TEMP_SAMPLE_RATE * 1000; // one update per bean reading
+const float PID_DT_S = PID_PERIOD_US / 1e6;
+const float PID_DERIVATIVE_TAU_S = 2.0;   // further low pass on its slope
+const PidGains DEFAULT_PID_GAINS = {40.0, 0.4, 300.0}; // counts per F, per F s, s per F
+const int HEAT_PICKUP_COUNTS = 64;        // dial must come within this of the output to take over
+const float AUTOTUNE_AMPLITUDE = POT_FULL_SCALE / 4;
+const float AUTOTUNE_HYSTERESIS_F = 1.0;  // a few thermocouple counts
+const float AUTOTUNE_TIMEOUT_S = 1800;
+const char *PID_NVS_NAMESPACE = "pid";
+
+// Rate of rise
+const int ROR_WINDOW = 60;             // bean readings in the regression, 15s
+const float MAX_ROR_TARGET_F_PER_MIN = 40.0;
+const float ROR_TARGET_RAMP = 0.5;     // F/min per second, how fast the target follows the dial
+const PidGains DEFAULT_ROR_GAINS = {60.0, 1.0, 0.0}; // counts per F/min, per F/min s
+
+// Model predictive heat. The model is fit with software/python roastomatic.thermal.
+const ThermalModel DEFAULT_THERMAL_MODEL = {70.0, 300.0, 20.0, 120.0};
+const float MPC_MOVE_PENALTY = 2e4; // F^2 per unit duty move squared
+
+// Kalman filters on the thermocouples, temperature and its rate.
+// Measurement noise grows with temperature; the bean rate follows the thermal
+// model's Newton heating toward the air while roasting.
+const KalmanNoise BEAN_KALMAN_NOISE = {3e-4, 0.5, 0.006, 70.0};
+const KalmanNoise INTAKE_KALMAN_NOISE = {1e-3, 0.5, 0.004, 70.0}; // the air moves faster
+const float KALMAN_RATE_TAU_S = 30.0; // how hard the model pulls the bean rate
+
+// Thermocouple calibration and lag, per probe, from software/python
+// roastomatic.probe. Uncalibrated probes read raw with no lag compensation.
+const char *PROBE_NVS_NAMESPACE = "probes";
+const float MAX_PROBE_LAG_S = 120.0;
+
+// Spike rejection ahead of the Kalman filters, for beans knocking the probe.
+// The load cell's is in Hx711Reader.
+const int THERMOCOUPLE_SPIKE_WINDOW = 7;        // readings, under 2s
+const float THERMOCOUPLE_SPIKE_THRESHOLD = 3.0; // robust standard deviations
+const float THERMOCOUPLE_QUANTUM_F = 0.45;      // the MAX6675's quarter degree C
+
+// Roast profiles, followed in ROAST under auto heat
+const int MAX_PROFILES = 4; // flash slots, picked with button 3
+const char *PROFILE_NVS_NAMESPACE = "profiles";
+
+const uint32_t TELEMETRY_PERIOD_US = 250000; // 4Hz serial csv
+const uint32_t DISPLAY_PERIOD_US = 1000000 / 60; // 60Hz display update rate
+
+// Tasks
+// Acquisition/control owns every sensor and actuator and runs on the app core.
+// Display/telemetry owns the OLED and Serial and runs on the other core, so a
+// slow I2C flush or a full serial buffer never delays a sensor read.
+const int CONTROL_TASK_CORE = 1;
+const int CONTROL_TASK_PRIORITY = 5;
+const int CONTROL_TASK_STACK = 4096;
+const uint32_t CONTROL_PERIOD_US = 10000; // 100Hz control tick from esp_timer
+const int UI_TASK_CORE = 0;
+const int UI_TASK_PRIORITY = 1;
+const int UI_TASK_STACK = 4096;
+const int UI_PERIOD_MS = 5;
+const uint32_t TASK_STATS_WINDOW_US = 5000000; // Report loop periods every 5s
+const uint32_t COMMAND_PERIOD_US = 20000;       // Poll serial for commands at 50Hz
+const int POT_TASK_CORE = 0;
+const int POT_TASK_PRIORITY = 2;
+
+// Safety supervisor, checked from a timer interrupt. NVS writes go through
+// nvs_write(), which holds the heartbeat off as flash stalls the control task.
+const uint32_t SAFETY_PERIOD_US = 1000;
+const SafetySupervisor::Limits SAFETY_LIMITS = {
+    500.0,                    // max bean F
+    575.0,                    // max intake F
+    POT_FULL_SCALE * 3 / 10,  // min fan counts while heating
+    5 * CONTROL_PERIOD_US,    // heartbeat timeout, 5 missed control ticks
+};
+const uint32_t SAFETY_STALL_US = 100000; // test_safety blocks the control task this long
 
 enum MANUAL_ROAST_STATES
 {
@@ -107,6 +242,7 @@ enum MANUAL_ROAST_STATES
 };
 
 enum MANUAL_ROAST_STATES manual_roast_state;
+enum MANUAL_ROAST_STATES last_manual_roast_state;
 
 // no more than 4 characters here
 const char *state_strings[] = {
@@ -120,13 +256,36 @@ const char *state_strings[] = {
     "done",
     "wrap"};
 
+enum HEAT_MODES
+{
+  MANUAL_HEAT,   // heat dial is the duty
+  AUTO_HEAT,     // heat dial is the setpoint, PID sets the duty
+  ROR_HEAT,      // heat dial is the rate of rise, PI on the RoR sets the duty
+  MPC_HEAT,      // heat dial is the setpoint, model predictive control sets the duty
+  AUTOTUNE_HEAT, // relay feedback around the bean temperature, then auto
+  NHEAT_MODES,
+};
+
+enum HEAT_MODES heat_mode = MANUAL_HEAT;
+enum HEAT_MODES last_heat_mode = MANUAL_HEAT;
+
+// no more than 4 characters here
+const char *heat_mode_strings[] = {
+    "man",
+    "auto",
+    "ror",
+    "mpc",
+    "tune"};
+
 // Switch between programs
 
 typedef void (*FunctionPointer)();
 struct Functions
 {
-  FunctionPointer setup;
-  FunctionPointer loop;
+  FunctionPointer setup;     // control task, once when selected
+  FunctionPointer control;   // control task, every control period
+  FunctionPointer loop;      // display/telemetry task, every display period
+  FunctionPointer telemetry; // display/telemetry task, every telemetry period
 };
 
 void test_buttons_setup();
@@ -135,6 +294,70 @@ void test_potentiometers_setup();
 void test_thermocouples_setup();
 void test_load_cell_setup();
 void manual_roast_setup();
+void calibrate_potentiometers_setup();
+void test_safety_setup();
+
+void do_nothing() {}
+void test_load_cell_control();
+void manual_roast_control();
+void calibrate_potentiometers_control();
+void test_safety_control();
+void manual_roast_telemetry();
+void test_safety_telemetry();
+void test_load_cell_telemetry();
+
+void control_task(void *parameter);
+void control_tick(void *arg);
+void ui_task(void *parameter);
+void load_pot_tables();
+void begin_safety_timer();
+void report_safety(int64_t now_us);
+void load_pid_gains();
+void load_profiles();
+void load_probe_calibrations();
+void load_load_cell_settings();
+void load_drop_targets();
+void apply_control_settings();
+void heat_control(int64_t now_us);
+void mpc_control(int64_t now_us);
+float bean_mass_g();
+
+void display_job();
+void telemetry_job();
+void stats_job();
+void command_job();
+
+// Serial commands, one per line: "<name> <args>"
+typedef void (*CommandFunction)(const char *args);
+struct Command
+{
+  const char *name;
+  CommandFunction run;
+};
+
+void profile_command(const char *args);
+void trace_command(const char *args);
+void pid_command(const char *args);
+void mpc_command(const char *args);
+void safety_command(const char *args);
+void roast_command(const char *args);
+void mains_command(const char *args);
+void probe_command(const char *args);
+void weight_command(const char *args);
+void drop_command(const char *args);
+
+const Command COMMANDS[] = {
+    {"profile", profile_command},
+    {"trace", trace_command},
+    {"mains", mains_command},
+    {"pid", pid_command},
+    {"mpc", mpc_command},
+    {"safety", safety_command},
+    {"roast", roast_command},
+    {"probe", probe_command},
+    {"weight", weight_command},
+    {"drop", drop_command},
+};
 
 void test_buttons();
 void test_display();
@@ -142,15 +365,19 @@ void test_potentiometers();
 void test_thermocouples();
 void test_load_cell();
 void manual_roast();
+void calibrate_potentiometers();
+void test_safety();
 
 // Selected Programs to run
 const Functions FUNCTIONS[] = {
-    //{test_buttons_setup, test_buttons},
-    //{test_display_setup, test_display},
-    //{test_potentiometers_setup, test_potentiometers},
-    //{test_thermocouples_setup, test_thermocouples},
-    //{test_load_cell_setup, test_load_cell},
-    {manual_roast_setup, manual_roast},
+    //{test_buttons_setup, do_nothing, test_buttons, do_nothing},
+    //{test_display_setup, do_nothing, test_display, do_nothing},
+    //{test_potentiometers_setup, do_nothing, test_potentiometers, do_nothing},
+    //{test_thermocouples_setup, do_nothing, test_thermocouples, do_nothing},
+    //{test_load_cell_setup, test_load_cell_control, test_load_cell, test_load_cell_telemetry},
+    //{calibrate_potentiometers_setup, calibrate_potentiometers_control, calibrate_potentiometers, do_nothing},
+    //{test_safety_setup, test_safety_control, test_safety, test_safety_telemetry},
+    {manual_roast_setup, manual_roast_control, manual_roast, manual_roast_telemetry},
 };
 
 /////////////////////////
@@ -160,16 +387,22 @@ const Functions FUNCTIONS[] = {
 // Potentiometer pins
 const int FAN_POT_PIN = 32;
 const int HEAT_POT_PIN = 33;
+const int POT_PINS[] = {FAN_POT_PIN, HEAT_POT_PIN};
+const int FAN_POT = 0; // index into POT_PINS
+const int HEAT_POT = 1;
 
 // Thermocouple pins
-// ESP32 Default SPI Pins
-// MOSI 23
-// MISO 19
-// SCK 18
-// SS 5
-const int MISO_PIN = 23;
+// Both MAX6675s share the VSPI clock and data lines. The data out (SO) line
+// is wired to GPIO 23, the VSPI MOSI pad. The GPIO matrix routes it to the
+// peripheral's MISO input, which is fine at the chip's 1MHz clock.
+const int THERMOCOUPLE_SCK_PIN = 18;
+const int THERMOCOUPLE_SO_PIN = 23;
 const int CS_BEAN_PIN = 5;
 const int CS_INTAKE_PIN = 4;
+const int THERMOCOUPLE_CS_PINS[] = {CS_BEAN_PIN, CS_INTAKE_PIN};
+const int BEAN_THERMOCOUPLE = 0; // index into THERMOCOUPLE_CS_PINS
+const int INTAKE_THERMOCOUPLE = 1;
+const char *thermocouple_names[] = {"bean", "intake"};
 
 // Screen pins
 const int I2C_SDA = 21;
@@ -179,11 +412,11 @@ const int I2C_SCL = 22;
 const int BUTTON_PINS[] = {15, 13, 12, 14, 27};
 const int NUM_BUTTONS = (sizeof(BUTTON_PINS) / sizeof(*BUTTON_PINS));
 
-// PWM pins
-const int HEAT_PWM_PIN = 26;
+// Output pins
+const int HEAT_SSR_PIN = 26;
 const int FAN_PWM_PIN = 25;
 
-// Load Cell Amplifier Pins
+// Load Cell Amplifier Pins. RATE is tied high for 80 SPS.
 const int LOAD_CELL_SCK_PIN = 16;
 const int LOAD_CELL_DT_PIN = 17;
 
@@ -201,29 +434,31 @@ Button buttons[NUM_BUTTONS] = {Button(BUTTON_PINS[0], (sizeof(FUNCTIONS) / sizeo
                                Button(BUTTON_PINS[2], 4), Button(BUTTON_PINS[3], 5),
                                Button(BUTTON_PINS[4], 6)};
 
+// Potentiometers, sampled continuously by the ADC's DMA
+PotSampler pots(POT_PINS);
+const PotTable *pot_tables[] = {&DEFAULT_POT_TABLE, &DEFAULT_POT_TABLE};
+PotTable calibrated_pot_tables[2];
+
+// Pot calibration sweep
+enum POT_CALIBRATION_STATUS
+{
+  SWEEPING,
+  SAVED,
+  REJECTED, // counts didn't rise with the dial
+  CLEARED,
+};
+PotCalibration pot_sweep[2];
+int pot_sweep_point = 0;
+enum POT_CALIBRATION_STATUS pot_calibration_status = SWEEPING;
+
 // Create an instance of the SSD1306 display
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
 // MAX6675 Thermocouple amplifiers
-MAX6675 bean_thermocouple(SCK, CS_BEAN_PIN, MISO_PIN);
-MAX6675 intake_thermocouple(SCK, CS_INTAKE_PIN, MISO_PIN);
-
-// Setup Heat PWM
-ledc_timer_config_t heat_timer = {
-    .speed_mode = HEAT_MODE,
-    .duty_resolution = HEAT_DUTY_RES,
-    .timer_num = HEAT_TIMER,
-    .freq_hz = HEAT_FREQUENCY,
-    .clk_cfg = LEDC_AUTO_CLK};
+Max6675Bus thermocouples(THERMOCOUPLE_CS_PINS, MIN_TEMP_SAMPLE_RATE * 1000);
 
-ledc_channel_config_t heat_channel = {
-    .gpio_num = HEAT_PWM_PIN,
-    .speed_mode = HEAT_MODE,
-    .channel = HEAT_CHANNEL,
-    .intr_type = LEDC_INTR_DISABLE,
-    .timer_sel = HEAT_TIMER,
-    .duty = 0,
-    .hpoint = 0};
+// Heater SSR, duty in linearized pot counts
+SsrHeater heater(HEAT_SSR_PIN, POT_FULL_SCALE);
 
 // Setup Fan PWM
 ledc_timer_config_t fan_timer = {
@@ -242,24 +477,129 @@ ledc_channel_config_t fan_channel = {
     .duty = 0,
     .hpoint = 0};
 
+LedcActuator fan_output(FAN_MODE, FAN_CHANNEL, FAN_QUANTUM, FAN_SLEW_PER_S, true);
+
 // Load Cell
-HX711 scale;
+Hx711Reader load_cell(LOAD_CELL_DT_PIN, LOAD_CELL_SCK_PIN);
 
 // Global variables
-int fan_value; // ADC value read at pin
-int fan_duty;  // Duty cycle in percent
-int fan_dial;  // Dial position
+int fan_value;    // ADC value read at pin
+int fan_position; // Linearized, 0 to POT_FULL_SCALE
+int fan_duty;     // Duty cycle in percent
+int fan_dial;     // Dial position
 int heat_value;
+int heat_position;
 int heat_duty;
 int heat_dial;
+int heat_output;      // counts actually sent to the heater
+int fan_target;       // counts sent to the fan
+bool heat_pickup;     // manual is waiting for the dial to reach heat_output
 float bean_temp_f;
 float intake_temp_f;
-
-int start_temp_sample;
+TemperatureKalman bean_kalman(BEAN_KALMAN_NOISE, KALMAN_RATE_TAU_S);
+TemperatureKalman intake_kalman(INTAKE_KALMAN_NOISE, KALMAN_RATE_TAU_S);
+ProbeCalibration probe_calibrations[Max6675Bus::NUM_CHIPS]; // written by the probe command
+portMUX_TYPE probe_calibrations_lock = portMUX_INITIALIZER_UNLOCKED;
+HampelFilter<THERMOCOUPLE_SPIKE_WINDOW> thermocouple_spikes[Max6675Bus::NUM_CHIPS] = {
+    {THERMOCOUPLE_SPIKE_THRESHOLD, THERMOCOUPLE_QUANTUM_F},
+    {THERMOCOUPLE_SPIKE_THRESHOLD, THERMOCOUPLE_QUANTUM_F}};
+float bean_estimate_f = NAN;     // lag compensated: what the display, roast states and PID see
+float bean_rate_f_per_min = NAN;
+float intake_estimate_f = NAN;
+int64_t thermocouple_read_us = 0; // last pair of readings
+bool new_temperature = false;     // a fresh pair this control pass
+
+// Automatic heat globals
+Pid pid(0, POT_FULL_SCALE, PID_DERIVATIVE_TAU_S);
+RelayAutotuner autotuner;
+float setpoint_f = 0;
+RorEstimator<ROR_WINDOW> bean_ror(PID_DT_S);
+float ror_f_per_min = NAN;
+Pid ror_pid(0, POT_FULL_SCALE, PID_DERIVATIVE_TAU_S);
+float ror_target = 0; // F/min
+MpcController mpc(DEFAULT_THERMAL_MODEL, MPC_MOVE_PENALTY);
+float mpc_duty = 0;
+uint32_t mpc_solve_us = 0;     // last
+uint32_t mpc_solve_us_max = 0; // since boot
+int64_t next_pid_us = 0;
+
+// Roast profile globals
+// The serial command fills the slots; the control task copies the selected one
+// into active_profile when it isn't roasting, so following it needs no lock.
+RoastProfile profiles[MAX_PROFILES];
+bool profile_loaded[MAX_PROFILES];
+std::atomic<uint32_t> profiles_generation{0}; // bumped on every upload or erase
+portMUX_TYPE profiles_lock = portMUX_INITIALIZER_UNLOCKED;
+RoastProfile active_profile;
+ProfileCursor profile_cursor;
+int selected_profile = -1;
+bool profile_active = false;    // a loaded profile is selected
+bool profile_following = false; // and it's driving the setpoint now
+uint32_t selected_generation = 0;
+uint8_t profile_upload[sizeof(RoastProfile)];
+size_t profile_upload_length = 0;
+size_t profile_upload_expected = 0;
+int profile_upload_slot = -1;
+
+// Safety globals
+enum SAFETY_FAULTS
+{
+  NO_FAULT,
+  HOT_FAULT,   // report a bean temperature over the limit
+  OPEN_FAULT,  // report a NAN bean temperature
+  FAN_FAULT,   // report heat with the fan off
+  STALL_FAULT, // block the control task
+  NSAFETY_FAULTS,
+};
+const char *safety_fault_strings[] = {"none", "hot", "open", "fan", "stall"};
+const char *safety_trip_strings[] = {"", "hot", "open", "fan", "beat"}; // 4 characters
+SafetySupervisor safety(SAFETY_LIMITS);
+gptimer_handle_t safety_timer;
+enum SAFETY_FAULTS safety_fault = NO_FAULT; // injected by test_safety
 
 // HX711 globals
 float raw;
 float weight;
+bool new_raw = false; // a fresh conversion was read this control pass
+Hx711Sample load_cell_samples[Hx711Reader::RING_SIZE]; // all of them, for test_load_cell
+int load_cell_sample_count = 0;
+Decimator load_cell_decimator;
+std::atomic<int> load_cell_filter{DEFAULT_DECIMATOR_SETTING}; // set by the weight command
+int active_load_cell_filter = -1;
+float load_cell_counts = NAN; // decimated
+bool new_weight = false;      // a decimated output this control pass
+SampleAverage weight_average;
+WeightEstimator weights(DEFAULT_LOAD_CELL_DRIFT, WEIGHT_NOISE);
+float weight_interval_g = NAN; // 95%, either side of weight
+int64_t load_cell_output_us = 0;
+
+// test_load_cell: every filter setting run side by side on the same samples
+struct DecimatorBench
+{
+  Decimator decimator;
+  uint32_t outputs;
+  double mean; // Welford
+  double m2;
+};
+DecimatorBench decimator_bench[N_DECIMATOR_SETTINGS];
+
+// What the serial commands change under the control task: the PID gains,
+// the thermal model and the load cell drift. A command writes them under
+// control_settings_lock and bumps the generation; the control task applies
+// them at the top of its next pass, so it's the only one touching pid,
+// ror_pid, mpc and weights.
+struct ControlSettings
+{
+  PidGains gains;
+  PidGains ror_gains;
+  ThermalModel model;
+  LoadCellDrift drift;
+};
+ControlSettings control_settings = {DEFAULT_PID_GAINS, DEFAULT_ROR_GAINS, DEFAULT_THERMAL_MODEL,
+                                    DEFAULT_LOAD_CELL_DRIFT};
+uint32_t control_settings_generation = 0; // under the lock
+uint32_t applied_settings_generation = 0; // control task
+portMUX_TYPE control_settings_lock = portMUX_INITIALIZER_UNLOCKED;
 
 // manual roast globals
 float drop_percent = 0;
@@ -267,11 +607,125 @@ int start_roast_time = 0;
 int elapsed_roast_time = 0;
 int start_total_time = 0;
 int elapsed_total_time = 0;
-int last_display_time = 0;
-int last_serial_write_time = 0;
+
+// Charge detection globals
+Cusum charge_cusum(CHARGE_CUSUM_DRIFT_G, CHARGE_CUSUM_THRESHOLD_G);
+Cusum bean_dip_cusum(BEAN_DIP_DRIFT_F, BEAN_DIP_THRESHOLD_F);
+int64_t charge_us = 0; // back dated, 0 until detected
+float charge_g = NAN;  // load when detected
+bool charge_logged = false;
+int calibrate_after = 0; // millis, lets a detected charge finish pouring
+
+// One per detected charge, for manual_roast_telemetry to log
+struct ChargeDetection
+{
+  uint32_t count;            // since boot
+  float charge_g;            // at START_SCALE, when detected
+  int32_t weight_latency_ms; // from the back dated charge to its detection
+  bool dip;                  // the bean probe corroborated it
+  int32_t dip_latency_ms;    // from the dip beginning to its detection
+  int32_t dip_offset_ms;     // dip beginning less the charge
+};
+ChargeDetection charge_detection = {};
+
+// Drop prediction globals
+DropPredictor<DROP_TREND_WINDOW> drop_predictor(DROP_TREND_PERIOD_S);
+DropTargets drop_targets = DEFAULT_DROP_TARGETS; // written by the drop command
+portMUX_TYPE drop_targets_lock = portMUX_INITIALIZER_UNLOCKED;
+float loss_percent_per_min = NAN;
+float drop_loss_s = NAN; // to each target
+float drop_end_s = NAN;
+float drop_countdown_s = NAN; // the sooner
+
+// Everything the display/telemetry task needs, published once per control pass
+struct Snapshot
+{
+  int program;
+  int fan_value;
+  int fan_duty;
+  int fan_dial;
+  int heat_value;
+  int heat_duty;
+  int heat_dial;
+  int heat_output_duty;
+  enum HEAT_MODES heat_mode;
+  float setpoint_f;
+  float ror_f_per_min;
+  float ror_target;
+  uint32_t mpc_solve_us;
+  SafetySupervisor::Trip safety_trip;
+  enum SAFETY_FAULTS safety_fault;
+  uint32_t mpc_solve_us_max;
+  int autotune_cycles;
+  int selected_profile;
+  bool profile_active;
+  int pot_sweep_point;
+  enum POT_CALIBRATION_STATUS pot_calibration_status;
+  float bean_temp_f;
+  float intake_temp_f;
+  float bean_estimate_f;
+  float bean_rate_f_per_min;
+  float intake_estimate_f;
+  float raw;
+  float weight;
+  float weight_interval_g;
+  float load_cell_counts;
+  float load_cell_zero_counts;
+  float load_cell_counts_per_g;
+  int load_cell_filter;
+  uint32_t load_cell_bench_outputs[N_DECIMATOR_SETTINGS];
+  double load_cell_bench_m2[N_DECIMATOR_SETTINGS];
+  uint32_t load_cell_captured;
+  uint32_t load_cell_dropped;
+  uint32_t load_cell_spikes;
+  uint32_t thermocouple_spikes[Max6675Bus::NUM_CHIPS];
+  enum MANUAL_ROAST_STATES manual_roast_state;
+  float drop_percent;
+  float loss_percent_per_min;
+  float drop_loss_s;
+  float drop_end_s;
+  float drop_countdown_s;
+  int weight_samples; // progress of tare/calibrate
+  ChargeDetection charge_detection;
+  int elapsed_roast_time;
+  int elapsed_total_time;
+  LoopPeriod control_period;
+  JitterSummary control_jitter;
+  uint32_t thermocouple_cpu_us;      // worst CPU time per read, both chips
+  uint32_t thermocouple_transfer_us; // last queue to completion, bean chip
+  uint32_t heater_half_cycles;
+  uint32_t heater_half_cycles_on;
+  uint32_t fan_writes_per_second;
+  uint32_t fan_coalesced;
+};
+
+TripleBuffer<Snapshot> snapshots;
+Snapshot ui; // The display/telemetry task's copy
+uint32_t charges_logged = 0;
+
+// task globals
+TaskHandle_t control_task_handle;
+TaskHandle_t ui_task_handle;
+LoopStats control_stats(TASK_STATS_WINDOW_US);
+JitterStats control_jitter(TASK_STATS_WINDOW_US);
+esp_timer_handle_t control_timer;
+int64_t control_timer_start_us;
+LoopStats ui_stats(TASK_STATS_WINDOW_US);
+
+// Display/telemetry task jobs
+Job ui_jobs[] = {
+    // name, run, period, priority, deadline, then the scheduler's bookkeeping
+    {"telemetry", telemetry_job, TELEMETRY_PERIOD_US, 0, TELEMETRY_PERIOD_US / 2, 0, 0, 0, 0, 0},
+    {"display", display_job, DISPLAY_PERIOD_US, 1, DISPLAY_PERIOD_US, 0, 0, 0, 0, 0},
+    {"stats", stats_job, TASK_STATS_WINDOW_US, 2, TASK_STATS_WINDOW_US / 10, 0, 0, 0, 0, 0},
+    {"commands", command_job, COMMAND_PERIOD_US, 3, COMMAND_PERIOD_US, 0, 0, 0, 0, 0},
+};
+char command_line[64];
+int command_length = 0;
+Scheduler ui_scheduler(ui_jobs, sizeof(ui_jobs) / sizeof(ui_jobs[0]), esp_timer_get_time);
 
 // program globals
-int current_program = 0;
+int current_program = -1;
 char displayArray1[8][22];
 char displayArray2[4][10];
 void set_display_row(int row, const char *format, ...)
@@ -292,10 +746,16 @@ void displayArray()
   {
     display.println(displayArray1[i]);
   }
+
+  PROFILE_BEGIN(PHASE_DISPLAY_FLUSH);
+  TRACE_BEGIN(TRACE_DISPLAY_FLUSH);
   display.display();
+  TRACE_END(TRACE_DISPLAY_FLUSH);
+  PROFILE_END(PHASE_DISPLAY_FLUSH);
 }
 void setup()
 {
+  Serial.setTxBufferSize(1024); // telemetry and trace lines queue rather than block the UI task
   Serial.begin(115200);
 
   // Initialize the OLED display
@@ -318,20 +778,259 @@ void setup()
   }
 
   // Initialize Potentiometers
-  pinMode(FAN_POT_PIN, INPUT);
-  pinMode(HEAT_POT_PIN, INPUT);
-
-  // Initialize Heat PWM
-  ESP_ERROR_CHECK(ledc_timer_config(&heat_timer));
-  ESP_ERROR_CHECK(ledc_channel_config(&heat_channel));
+  load_pot_tables();
+  load_pid_gains();
+  load_profiles();
+  load_probe_calibrations();
+  load_load_cell_settings();
+  load_drop_targets();
+  pots.begin(POT_TASK_CORE, POT_TASK_PRIORITY);
+
+  // Initialize Thermocouples
+  thermocouples.begin(THERMOCOUPLE_HOST, THERMOCOUPLE_SCK_PIN, THERMOCOUPLE_SO_PIN);
+
+  // Initialize Heater
+  uint32_t mains_hz = DEFAULT_MAINS_FREQUENCY;
+  Preferences preferences;
+  preferences.begin(HEATER_NVS_NAMESPACE, true);
+  preferences.getBytes("mains_hz", &mains_hz, sizeof(mains_hz));
+  preferences.end();
+  heater.begin(mains_hz);
 
   // Initialize Fan PWM
   ESP_ERROR_CHECK(ledc_timer_config(&fan_timer));
   ESP_ERROR_CHECK(ledc_channel_config(&fan_channel));
+  fan_output.begin();
+
+  // The load cell is started by each program's setup
+
+  // Start the tasks. The loop task is no longer needed after this.
+  xTaskCreatePinnedToCore(control_task, "control", CONTROL_TASK_STACK, NULL,
+                          CONTROL_TASK_PRIORITY, &control_task_handle, CONTROL_TASK_CORE);
+  xTaskCreatePinnedToCore(ui_task, "ui", UI_TASK_STACK, NULL,
+                          UI_TASK_PRIORITY, &ui_task_handle, UI_TASK_CORE);
+
+  // The control task runs once per tick of this timer
+  esp_timer_create_args_t control_timer_args = {
+      .callback = control_tick,
+      .arg = NULL,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "control",
+      .skip_unhandled_events = true};
+  ESP_ERROR_CHECK(esp_timer_create(&control_timer_args, &control_timer));
+  control_timer_start_us = esp_timer_get_time();
+  ESP_ERROR_CHECK(esp_timer_start_periodic(control_timer, CONTROL_PERIOD_US));
+
+  begin_safety_timer();
+}
+
+// Runs in the timer interrupt. While tripped the heater is forced off again
+// every period, so a half-cycle decided just before the trip can't stick.
+bool IRAM_ATTR safety_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *event, void *arg)
+{
+  if (safety.check((uint32_t)esp_timer_get_time()) != SafetySupervisor::NONE)
+  {
+    heater.trip();
+  }
+  return false;
+}
+
+void begin_safety_timer()
+{
+  gptimer_config_t config = {};
+  config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+  config.direction = GPTIMER_COUNT_UP;
+  config.resolution_hz = 1000000;
+  ESP_ERROR_CHECK(gptimer_new_timer(&config, &safety_timer));
+
+  gptimer_event_callbacks_t callbacks = {};
+  callbacks.on_alarm = safety_alarm;
+  ESP_ERROR_CHECK(gptimer_register_event_callbacks(safety_timer, &callbacks, NULL));
+  ESP_ERROR_CHECK(gptimer_enable(safety_timer));
+
+  gptimer_alarm_config_t alarm = {};
+  alarm.alarm_count = SAFETY_PERIOD_US;
+  alarm.flags.auto_reload_on_alarm = true;
+  ESP_ERROR_CHECK(gptimer_set_alarm_action(safety_timer, &alarm));
+  ESP_ERROR_CHECK(gptimer_start(safety_timer));
+}
+
+// Use the calibrated tables from NVS where there are good ones
+void load_pot_tables()
+{
+  Preferences preferences;
+  preferences.begin(POT_NVS_NAMESPACE, true);
+  for (int pot = 0; pot < 2; pot++)
+  {
+    PotCalibration calibration;
+    if (preferences.getBytes(POT_NVS_KEYS[pot], &calibration, sizeof(calibration)) == sizeof(calibration) &&
+        pot_calibration_valid(calibration))
+    {
+      calibrated_pot_tables[pot] = make_pot_table(calibration);
+      pot_tables[pot] = &calibrated_pot_tables[pot];
+    }
+    else
+    {
+      pot_tables[pot] = &DEFAULT_POT_TABLE;
+    }
+  }
+  preferences.end();
+}
+
+// Any task
+ControlSettings read_control_settings()
+{
+  taskENTER_CRITICAL(&control_settings_lock);
+  ControlSettings settings = control_settings;
+  taskEXIT_CRITICAL(&control_settings_lock);
+  return settings;
+}
+
+void write_control_settings(const ControlSettings &settings)
+{
+  taskENTER_CRITICAL(&control_settings_lock);
+  control_settings = settings;
+  control_settings_generation++;
+  taskEXIT_CRITICAL(&control_settings_lock);
+}
+
+// Control task, top of every pass
+void apply_control_settings()
+{
+  ControlSettings settings;
+  bool changed = false;
+  taskENTER_CRITICAL(&control_settings_lock);
+  if (applied_settings_generation != control_settings_generation)
+  {
+    settings = control_settings;
+    applied_settings_generation = control_settings_generation;
+    changed = true;
+  }
+  taskEXIT_CRITICAL(&control_settings_lock);
+  if (changed)
+  {
+    pid.set_gains(settings.gains);
+    ror_pid.set_gains(settings.ror_gains);
+    mpc.set_model(settings.model);
+    weights.set_drift(settings.drift);
+  }
+}
+
+void load_pid_gains()
+{
+  PidGains gains = DEFAULT_PID_GAINS;
+  PidGains ror_gains = DEFAULT_ROR_GAINS;
+  Preferences preferences;
+  preferences.begin(PID_NVS_NAMESPACE, true);
+  preferences.getBytes("gains", &gains, sizeof(gains));
+  preferences.getBytes("ror_gains", &ror_gains, sizeof(ror_gains));
+  ThermalModel model = DEFAULT_THERMAL_MODEL;
+  preferences.getBytes("model", &model, sizeof(model));
+  preferences.end();
+  ControlSettings settings = read_control_settings();
+  settings.gains = gains;
+  settings.ror_gains = ror_gains;
+  settings.model = model;
+  write_control_settings(settings);
+}
+
+// Every NVS write goes through these, as the flash stalls the control task
+// past the safety heartbeat, which is held off until it's done
+void nvs_write(const char *name_space, const char *key, const void *data, size_t size)
+{
+  Preferences preferences;
+  safety.hold();
+  preferences.begin(name_space, false);
+  preferences.putBytes(key, data, size);
+  preferences.end();
+  safety.release((uint32_t)esp_timer_get_time());
+}
+
+// A NULL key clears the whole namespace
+void nvs_erase(const char *name_space, const char *key)
+{
+  Preferences preferences;
+  safety.hold();
+  preferences.begin(name_space, false);
+  if (key == NULL)
+  {
+    preferences.clear();
+  }
+  else
+  {
+    preferences.remove(key);
+  }
+  preferences.end();
+  safety.release((uint32_t)esp_timer_get_time());
+}
+
+void profile_key(int slot, char *key)
+{
+  snprintf(key, 4, "%d", slot);
+}
+
+void load_profiles()
+{
+  Preferences preferences;
+  preferences.begin(PROFILE_NVS_NAMESPACE, true);
+  for (int slot = 0; slot < MAX_PROFILES; slot++)
+  {
+    char key[4];
+    profile_key(slot, key);
+    size_t length = preferences.getBytes(key, profile_upload, sizeof(profile_upload));
+    profile_loaded[slot] = profile_load(profile_upload, length, profiles[slot]);
+  }
+  preferences.end();
+}
 
-  // Initialize Load Cell
-  scale.begin(LOAD_CELL_DT_PIN, LOAD_CELL_SCK_PIN, false);
-  // scale.set_scale(START_SCALE);
+void load_probe_calibrations()
+{
+  Preferences preferences;
+  preferences.begin(PROBE_NVS_NAMESPACE, true);
+  for (int probe = 0; probe < Max6675Bus::NUM_CHIPS; probe++)
+  {
+    probe_calibrations[probe] = PROBE_IDENTITY;
+    preferences.getBytes(thermocouple_names[probe], &probe_calibrations[probe], sizeof(ProbeCalibration));
+  }
+  preferences.end();
+}
+
+void load_drop_targets()
+{
+  Preferences preferences;
+  preferences.begin(DROP_NVS_NAMESPACE, true);
+  preferences.getBytes("targets", &drop_targets, sizeof(drop_targets));
+  preferences.end();
+}
+
+void load_load_cell_settings()
+{
+  LoadCellDrift drift = DEFAULT_LOAD_CELL_DRIFT;
+  Preferences preferences;
+  preferences.begin(LOAD_CELL_NVS_NAMESPACE, true);
+  preferences.getBytes("drift", &drift, sizeof(drift));
+  int filter = DEFAULT_DECIMATOR_SETTING;
+  preferences.getBytes("filter", &filter, sizeof(filter));
+  preferences.end();
+  ControlSettings settings = read_control_settings();
+  settings.drift = drift;
+  write_control_settings(settings);
+  load_cell_filter = (filter >= 0 && filter < N_DECIMATOR_SETTINGS) ? filter : DEFAULT_DECIMATOR_SETTING;
+}
+
+// Control task. slot -1 is no profile.
+void select_profile(int slot)
+{
+  taskENTER_CRITICAL(&profiles_lock);
+  selected_profile = slot;
+  profile_active = (slot >= 0) && profile_loaded[slot];
+  if (profile_active)
+  {
+    active_profile = profiles[slot];
+    profile_cursor.attach(&active_profile);
+  }
+  selected_generation = profiles_generation.load();
+  taskEXIT_CRITICAL(&profiles_lock);
 }
 
 void test_buttons_setup() {}
@@ -379,9 +1078,9 @@ void test_potentiometers()
   display.println("");
   display.println("Pot   Res Duty Dial");
   display.println("-------------------");
-  snprintf(buffer, 22, "Fan  %4d %3d%% %1d.%02d", fan_value, fan_duty, fan_dial / 100, fan_dial % 100);
+  snprintf(buffer, 22, "Fan  %4d %3d%% %1d.%02d", ui.fan_value, ui.fan_duty, ui.fan_dial / 100, ui.fan_dial % 100);
   display.println(buffer);
-  snprintf(buffer, 22, "Heat %4d %3d%% %1d.%02d", heat_value, heat_duty, heat_dial / 100, heat_dial % 100);
+  snprintf(buffer, 22, "Heat %4d %3d%% %1d.%02d", ui.heat_value, ui.heat_duty, ui.heat_dial / 100, ui.heat_dial % 100);
   display.println(buffer);
   snprintf(buffer, 22, "SSR LED should match duty");
   display.println(buffer);
@@ -396,8 +1095,8 @@ void test_thermocouples()
   set_display_row(i++, "%s", "Test Thermocouples");
   set_display_row(i++, "%s", "Therm.   F. deg.");
   set_display_row(i++, "%s", "-------------------");
-  set_display_row(i++, "Intake  %s", dtostrf(intake_temp_f, 6, 2, float_str));
-  set_display_row(i++, "Bean    %s", dtostrf(bean_temp_f, 6, 2, float_str));
+  set_display_row(i++, "Intake  %s", dtostrf(ui.intake_temp_f, 6, 2, float_str));
+  set_display_row(i++, "Bean    %s", dtostrf(ui.bean_temp_f, 6, 2, float_str));
   set_display_row(i++, "%s", "");
   set_display_row(i++, "%s", "");
   set_display_row(i++, "%s", "");
@@ -405,6 +1104,81 @@ void test_thermocouples()
 }
 
 void test_load_cell_setup()
+{
+  // Every decimation setting runs on the same conversions. Keep the pan
+  // still: the spread of each one's output is its noise.
+  // button 1 restarts the measurement
+  load_cell.begin();
+  buttons[1].setNStates(2);
+  for (int i = 0; i < N_DECIMATOR_SETTINGS; i++)
+  {
+    decimator_bench[i].decimator.configure(DECIMATOR_SETTINGS[i]);
+    decimator_bench[i].outputs = 0;
+    decimator_bench[i].mean = 0;
+    decimator_bench[i].m2 = 0;
+  }
+}
+
+void test_load_cell_control()
+{
+  if (buttons[1].changed())
+  {
+    test_load_cell_setup();
+    buttons[1].reset();
+  }
+  for (int s = 0; s < load_cell_sample_count; s++)
+  {
+    for (DecimatorBench &bench : decimator_bench)
+    {
+      if (bench.decimator.add(load_cell_samples[s].raw))
+      {
+        double x = bench.decimator.output();
+        double delta = x - bench.mean;
+        bench.outputs++;
+        bench.mean += delta / bench.outputs;
+        bench.m2 += delta * (x - bench.mean);
+      }
+    }
+  }
+}
+
+// Grams RMS at the nominal scale
+float bench_noise_g(int i)
+{
+  uint32_t n = ui.load_cell_bench_outputs[i];
+  return (n > 1) ? sqrtf(ui.load_cell_bench_m2[i] / (n - 1)) / START_SCALE : NAN;
+}
+
+float bench_delay_ms(int i)
+{
+  return decimator_bench[i].decimator.group_delay() / LOAD_CELL_SPS * 1000;
+}
+
+void test_load_cell()
+{
+  char float_str[8];
+  int i = 0;
+  set_display_row(i++, "Scale filter   g  ms");
+  for (int s = 0; s < N_DECIMATOR_SETTINGS && i < 7; s++)
+  {
+    set_display_row(i++, "%c%-10s%s%4.0f", (s == ui.load_cell_filter) ? '*' : ' ', DECIMATOR_SETTINGS[s].name,
+                    dtostrf(bench_noise_g(s), 5, 2, float_str), bench_delay_ms(s));
+  }
+  set_display_row(i++, "%s", "1: restart");
+  displayArray();
+}
+
+void test_load_cell_telemetry()
+{
+  for (int s = 0; s < N_DECIMATOR_SETTINGS; s++)
+  {
+    Serial.printf("%s,%.1f,%.3f,%.0f,%" PRIu32 "\n", DECIMATOR_SETTINGS[s].name,
+                  LOAD_CELL_SPS / decimator_bench[s].decimator.decimation(), bench_noise_g(s),
+                  bench_delay_ms(s), ui.load_cell_bench_outputs[s]);
+  }
+}
+
+void manual_roast_setup()
 {
   // button 1 Calls the Tare
   // button 2 Calibrates 100.0g
@@ -415,68 +1189,197 @@ void test_load_cell_setup()
   // Then, you get the raw value upside down.
   // and with 100g.
   // you should be able to calculate the weight of just the top part, and then store an offset
+
+  load_cell.begin();
+  weights.reset();
+
   buttons[1].setNStates(2);
+  // button 2 steps the heat through the HEAT_MODES: manual, auto, ror, mpc and autotune
   buttons[2].setNStates(2);
-  buttons[3].setNStates(5);
-  buttons[4].setNStates(8);
+  // button 3 picks the roast profile, 0 for none
+  buttons[3].setNStates(MAX_PROFILES + 1);
+  manual_roast_state = READY;
+  last_manual_roast_state = NSTATES;
 }
 
-void test_load_cell()
+void calibrate_potentiometers_setup()
+{
+  // Set both dials to each reference position in turn.
+  // button 1 captures the position
+  // button 2 forgets the calibration and goes back to the linear default
+  buttons[1].setNStates(2);
+  buttons[2].setNStates(2);
+  pot_sweep_point = 0;
+  pot_calibration_status = SWEEPING;
+}
+
+void calibrate_potentiometers_control()
+{
+  if (buttons[1].changed())
+  {
+    pot_sweep[FAN_POT].counts[pot_sweep_point] = fan_value;
+    pot_sweep[HEAT_POT].counts[pot_sweep_point] = heat_value;
+    pot_calibration_status = SWEEPING;
+    if (++pot_sweep_point == POT_REFERENCE_POINTS)
+    {
+      pot_sweep_point = 0;
+      if (pot_calibration_valid(pot_sweep[FAN_POT]) && pot_calibration_valid(pot_sweep[HEAT_POT]))
+      {
+        for (int pot = 0; pot < 2; pot++)
+        {
+          nvs_write(POT_NVS_NAMESPACE, POT_NVS_KEYS[pot], &pot_sweep[pot], sizeof(pot_sweep[pot]));
+        }
+        load_pot_tables();
+        pot_calibration_status = SAVED;
+      }
+      else
+      {
+        pot_calibration_status = REJECTED;
+      }
+    }
+    buttons[1].reset();
+  }
+  if (buttons[2].changed())
+  {
+    nvs_erase(POT_NVS_NAMESPACE, NULL);
+    load_pot_tables();
+    pot_sweep_point = 0;
+    pot_calibration_status = CLEARED;
+    buttons[2].reset();
+  }
+}
+
+void calibrate_potentiometers()
+{
+  const char *status_strings[] = {"", "Saved", "Rejected, not rising", "Cleared"};
+  int dial = POT_REFERENCE_DIAL[ui.pot_sweep_point];
+  int i = 0;
+  set_display_row(i++, "%s", "Calibrate Pots");
+  set_display_row(i++, "Set both dials to %d.%02d", dial / 100, dial % 100);
+  set_display_row(i++, "then press button 1");
+  set_display_row(i++, "Point %d of %d", ui.pot_sweep_point + 1, POT_REFERENCE_POINTS);
+  set_display_row(i++, "Fan  %4d -> %d.%02d", ui.fan_value, ui.fan_dial / 100, ui.fan_dial % 100);
+  set_display_row(i++, "Heat %4d -> %d.%02d", ui.heat_value, ui.heat_dial / 100, ui.heat_dial % 100);
+  set_display_row(i++, "%s", status_strings[ui.pot_calibration_status]);
+  set_display_row(i++, "%s", "Button 2: defaults");
+  displayArray();
+}
+
+void test_safety_setup()
+{
+  // button 1 picks a fault to inject
+  // button 2 clears it and resets the supervisor
+  buttons[1].setNStates(2);
+  buttons[2].setNStates(2);
+  safety_fault = NO_FAULT;
+}
+
+void test_safety_control()
 {
   if (buttons[1].changed())
   {
-    delay(2000);
-    scale.tare();
+    safety_fault = (SAFETY_FAULTS)((safety_fault + 1) % NSAFETY_FAULTS);
     buttons[1].reset();
   }
   if (buttons[2].changed())
   {
-    delay(2000);
-    scale.calibrate_scale(100);
+    safety_fault = NO_FAULT;
+    report_safety(esp_timer_get_time());
+    if (safety.reset())
+    {
+      heater.clear_trip();
+    }
     buttons[2].reset();
   }
-  if (buttons[3].changed())
+  if (safety_fault == STALL_FAULT && !heater.tripped())
   {
-    // set hx711 mode
-    int index = buttons[3].count();
-    (scale.*(HX711_MODES[index].mode))();
+    // Like a blocked I2C transaction; only the interrupt can notice
+    esp_rom_delay_us(SAFETY_STALL_US);
   }
+}
 
-  char float_str[15];
+void test_safety()
+{
   int i = 0;
-  set_display_row(i++, "%s", "Test Scale");
-  set_display_row(i++, "Mode:%d  %s", scale.get_mode(), HX711_MODES[buttons[3].count()].text);
-  set_display_row(i++, "Offset:%d", (int32_t)scale.get_offset());
-  set_display_row(i++, "Tare:  %d", (int32_t)scale.get_tare());
-  set_display_row(i++, "Scale: %s", dtostrf(scale.get_scale(), 13, 2, float_str));
-  set_display_row(i++, "Value: %d", (int32_t)scale.get_value());
-  set_display_row(i++, "Gain:  %d", scale.get_gain());
+  set_display_row(i++, "%s", "Safety Supervisor");
+  set_display_row(i++, "Inject: %s", safety_fault_strings[ui.safety_fault]);
+  set_display_row(i++, "State: %s", SafetySupervisor::name(ui.safety_trip));
+  set_display_row(i++, "Trips: %" PRIu32, safety.trips());
+  set_display_row(i++, "Latency: %" PRIu32 " us", safety.latency_us());
+  set_display_row(i++, "Max: %" PRIu32 " us", safety.max_latency_us());
+  set_display_row(i++, "%s", "1: fault  2: reset");
   displayArray();
 }
-void manual_roast_setup()
+
+void test_safety_telemetry()
 {
-  // button 1 Calls the Tare
-  // button 2 Calibrates 100.0g
-  // button 3 Switches between mode
-  // If you weigh the whole apparatus,
-  // Then get the raw value right side up
-  // and with 100g.
-  // Then, you get the raw value upside down.
-  // and with 100g.
-  // you should be able to calculate the weight of just the top part, and then store an offset
+  Serial.printf("%s,%s,%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n", safety_fault_strings[ui.safety_fault],
+                SafetySupervisor::name(ui.safety_trip), safety.trips(), safety.latency_us(),
+                safety.max_latency_us());
+}
 
-  buttons[1].setNStates(2);
-  manual_roast_state = READY;
+// The charge cools the bean probe faster than its filter predicts. Watched
+// from LOAD, in case it comes first, until it confirms a detected charge or
+// BEAN_DIP_WINDOW_MS goes by without it.
+void watch_charge()
+{
+  bool watching = (manual_roast_state == LOAD) || (charge_us != 0 && !charge_logged);
+  if (!watching)
+  {
+    return;
+  }
+  if (new_temperature && bean_kalman.ready())
+  {
+    bean_dip_cusum.add(-bean_kalman.innovation_f(), thermocouple_read_us);
+  }
+  int64_t now_us = esp_timer_get_time();
+  if (charge_us == 0)
+  {
+    // A dip too long before the charge was the heat, not the beans
+    if (bean_dip_cusum.alarmed() && now_us - bean_dip_cusum.change_us() > BEAN_DIP_WINDOW_MS * 1000LL)
+    {
+      bean_dip_cusum.reset();
+    }
+    return;
+  }
+  if (!bean_dip_cusum.alarmed() && now_us - charge_us < BEAN_DIP_WINDOW_MS * 1000LL)
+  {
+    return;
+  }
+  ChargeDetection detection = {};
+  detection.count = charge_detection.count + 1;
+  detection.charge_g = charge_g;
+  detection.weight_latency_ms = (charge_cusum.alarm_us() - charge_us) / 1000;
+  detection.dip = bean_dip_cusum.alarmed();
+  detection.dip_latency_ms = bean_dip_cusum.latency_us() / 1000;
+  detection.dip_offset_ms = (bean_dip_cusum.change_us() - charge_us) / 1000;
+  charge_detection = detection;
+  charge_logged = true;
 }
 
-void manual_roast()
+// Every control pass in ROAST
+void predict_drop()
+{
+  DropTargets targets;
+  taskENTER_CRITICAL(&drop_targets_lock);
+  targets = drop_targets;
+  taskEXIT_CRITICAL(&drop_targets_lock);
+  drop_predictor.update(weight, bean_estimate_f, bean_rate_f_per_min, CONTROL_PERIOD_US / 1e6);
+  loss_percent_per_min = drop_predictor.loss_percent_per_min();
+  drop_loss_s = drop_predictor.seconds_to_loss(targets.loss_percent);
+  drop_end_s = drop_predictor.seconds_to_temperature(targets.end_f);
+  drop_countdown_s = drop_predictor.seconds_remaining(targets);
+}
+
+void manual_roast_control()
 {
   // manual_roast
   // Heat and Fan are controlled by the potentiometers.
   // Steps preheat-tare-load-calibrate-roast-drop-done
   // Preheat - wait until the inside temp is higher than a french roast would be 455F
   // Tare - automatically happens with maximal sample rate.  Then switches to load.
-  // Load - Look for weights above 50g.  When it detects that for at least 2 seconds
+  // Load - CUSUM on the weight detects the charge, back dates the roast timer
+  // to it and logs it with the bean probe dip
   // Calibrate @ 100g - a bunch of times, start timer, percent down
   // Roast - Timer proceeds until weight is x% and then says "drop"
   // Drop - Do nothing, you should just cut the heat manually.
@@ -491,6 +1394,26 @@ void manual_roast()
     manual_roast_state = (MANUAL_ROAST_STATES)((manual_roast_state + 1) % NSTATES);
     buttons[1].reset();
   }
+  if (buttons[2].changed())
+  {
+    heat_mode = (HEAT_MODES)((heat_mode + 1) % NHEAT_MODES);
+    buttons[2].reset();
+  }
+
+  bool entered = (manual_roast_state != last_manual_roast_state);
+  last_manual_roast_state = manual_roast_state;
+  if (entered)
+  {
+    TRACE_INSTANT(TRACE_STATE, manual_roast_state);
+  }
+
+  // The profile can't change under a roast, not even by an upload
+  if (manual_roast_state != ROAST &&
+      (buttons[3].count() - 1 != selected_profile || profiles_generation.load() != selected_generation))
+  {
+    select_profile(buttons[3].count() - 1);
+  }
+  profile_following = profile_active && manual_roast_state == ROAST;
 
   switch (manual_roast_state)
   {
@@ -499,150 +1422,1134 @@ void manual_roast()
     manual_roast_state = PREHEAT;
     break;
   case (PREHEAT): // until a reach a temperature
-    if (intake_temp_f >= MIN_TEMP_FOR_PREHEAT)
+    if (intake_estimate_f >= MIN_TEMP_FOR_PREHEAT)
     {
       manual_roast_state = TARE;
     }
     break;
-  case (TARE):
-    scale.tare(); // This is blocking code
-    manual_roast_state = LOAD;
+  case (TARE): // one sample per pass so the outputs and telemetry keep running
+    if (entered)
+    {
+      weight_average.start(N_WEIGHT_SAMPLES);
+    }
+    if (new_weight && weight_average.add(lroundf(load_cell_counts))) // the pan is zeroed as these come in
+    {
+      manual_roast_state = LOAD;
+    }
     break;
-  case (LOAD):
-    /*
-    if (weight > (0.5 * ROAST_WEIGHT_GRAMS))
+  case (LOAD): // until the charge is detected, or the button
+    if (entered)
+    {
+      charge_cusum.reset();
+      bean_dip_cusum.reset();
+      charge_us = 0;
+      charge_logged = false;
+    }
+    if (new_weight && weights.zeroed())
     {
-      start_roast_time = t;
+      charge_g = (load_cell_counts - weights.zero_counts()) / START_SCALE;
+    }
+    if (new_weight && weights.zeroed() && charge_cusum.add(charge_g, load_cell_output_us))
+    {
+      // The decimator's output lags the load by its group delay
+      float delay_us = load_cell_decimator.group_delay() / LOAD_CELL_SPS * 1e6;
+      charge_us = charge_cusum.change_us() - (int64_t)delay_us;
+      start_roast_time = t - (esp_timer_get_time() - charge_us) / 1000;
+      calibrate_after = t + CHARGE_SETTLE_MS;
       manual_roast_state = CALIBRATE;
     }
-    */
     break;
   case (CALIBRATE):
-    start_roast_time = t;
-    scale.calibrate_scale(ROAST_WEIGHT_GRAMS); // This is blocking code
-    manual_roast_state = ROAST;
+    if (entered)
+    {
+      if (charge_us == 0)
+      {
+        start_roast_time = t;
+        calibrate_after = t;
+      }
+      weight_average.start(N_WEIGHT_SAMPLES);
+    }
+    if (new_weight && t >= calibrate_after && weight_average.add(lroundf(load_cell_counts)))
+    {
+      weights.calibrate(weight_average.mean(), ROAST_WEIGHT_GRAMS, intake_estimate_f);
+      manual_roast_state = ROAST;
+    }
     break;
   case (ROAST):
-    if (heat_duty <= MAX_HEAT_DUTY_FOR_DROP) // percent
+    if (entered)
+    {
+      drop_predictor.reset(ROAST_WEIGHT_GRAMS);
+    }
+    if (heat_duty <= MAX_HEAT_DUTY_FOR_DROP) // percent of the dial, in auto too
     {
       manual_roast_state = DROP;
     }
     drop_percent = 100 * (ROAST_WEIGHT_GRAMS - weight) / ROAST_WEIGHT_GRAMS;
     elapsed_roast_time = t - start_roast_time;
+    predict_drop();
     break;
   case (DROP):
-    if (bean_temp_f < MAX_BEAN_TEMP_FOR_DONE)
+    if (bean_estimate_f < MAX_BEAN_TEMP_FOR_DONE)
     {
       manual_roast_state = DONE;
     }
     break;
   }
 
-  elapsed_total_time = t - start_total_time;
+  watch_charge();
 
-  if (t - last_display_time > MIN_DISPLAY_RATE)
-  {
-    // bigger display than normal
-    display.clearDisplay();
-    display.setTextSize(2);
-    display.setCursor(0, 0);
-
-    // line 0
-    char buffer[11];
-    char float_string[5];
-    dtostrf((drop_percent > 0.0) ? drop_percent : 0.0, 4, 2, float_string);
-    snprintf(buffer, 10, "%s %s", state_strings[manual_roast_state], float_string);
-    display.println(buffer);
-
-    // line 1
-    snprintf(buffer, 11, "%01ld:%02ld %02ld:%02ld",
-             elapsed_roast_time / (60 * 1000), // Minutes
-             (elapsed_roast_time / 1000) % 60, // Seconds
-             elapsed_total_time / (60 * 1000), // Minutes
-             (elapsed_total_time / 1000) % 60  // Seconds
-    );
-    display.println(buffer);
-
-    // line 2
-    dtostrf(bean_temp_f, 4, 1, float_string);
-    snprintf(buffer, 11, "%03d %s", fan_duty, float_string);
-    display.println(buffer);
-
-    // line 3
-    dtostrf(intake_temp_f, 4, 1, float_string);
-    snprintf(buffer, 11, "%03d %s", heat_duty, float_string);
-    display.println(buffer);
-    display.display();
-
-    last_display_time = t;
-  }
-  // Write a csv file to serial.
-  if ((t - last_serial_write_time) > MIN_SERIAL_PRINT_RATE)
-  {
-    Serial.print(elapsed_roast_time);
-    Serial.print(",");
-    Serial.print(elapsed_total_time);
-    Serial.print(",");
-    Serial.print(state_strings[manual_roast_state]);
-    Serial.print(",");
-    Serial.print(fan_value);
-    Serial.print(",");
-    Serial.print(heat_value);
-    Serial.print(",");
-    Serial.print(bean_temp_f);
-    Serial.print(",");
-    Serial.print(intake_temp_f);
-    Serial.print(",");
-    Serial.print(weight);
-    Serial.print(",");
-    Serial.print(drop_percent);
-    Serial.println("");
-    last_serial_write_time = t;
+  // Only counting down while roasting
+  if (manual_roast_state != ROAST)
+  {
+    drop_loss_s = NAN;
+    drop_end_s = NAN;
+    drop_countdown_s = NAN;
   }
+
+  elapsed_total_time = t - start_total_time;
 }
 
-void loop()
+void manual_roast()
 {
-  // Read the raw ADC potentiometer values
-  fan_value = analogRead(FAN_POT_PIN);
-  heat_value = analogRead(HEAT_POT_PIN);
-
-  fan_duty = (fan_value * 100) / MAX_POT_VALUE;
-  heat_duty = (heat_value * 100) / MAX_POT_VALUE;
-
-  fan_dial = (MAX_DIAL * fan_value * 100.0) / MAX_POT_VALUE;
-  heat_dial = (MAX_DIAL * heat_value * 100.0) / MAX_POT_VALUE;
+  // bigger display than normal
+  display.clearDisplay();
+  display.setTextSize(2);
+  display.setCursor(0, 0);
 
-  // Read the MAX6675 amplified thermocouples
-  int t = millis();
-  int elapsed_temp_sample = t - start_temp_sample;
-  if (elapsed_temp_sample >= MIN_TEMP_SAMPLE_RATE)
+  // line 0
+  char buffer[11];
+  char float_string[5];
+  if (ui.safety_trip != SafetySupervisor::NONE)
   {
-    bean_temp_f = bean_thermocouple.readFarenheit();
-    intake_temp_f = intake_thermocouple.readFarenheit();
-    start_temp_sample = t;
+    snprintf(buffer, 11, "trip %s", safety_trip_strings[ui.safety_trip]);
   }
-
-  // Set the duty cycle of the heat PWM based on heat potentiometer
-  ledc_set_duty(HEAT_MODE, HEAT_CHANNEL, heat_value);
-  ledc_update_duty(HEAT_MODE, HEAT_CHANNEL);
-
-  // Set the duty cycle of the fan PWM based on fan potentiometer
-  ledc_set_duty(FAN_MODE, FAN_CHANNEL, fan_value);
-  ledc_update_duty(FAN_MODE, FAN_CHANNEL);
-
-  // Read the raw weight
-  if ((t - scale.last_time_read()) >= MIN_LOAD_CELL_SAMPLE_RATE)
+  else if (ui.manual_roast_state == TARE || ui.manual_roast_state == CALIBRATE)
   {
-    raw = scale.read(); // raw has least amount of blocking
-    weight = scale.get_units();
+    snprintf(buffer, 11, "%s %02d/%02d", state_strings[ui.manual_roast_state], ui.weight_samples, N_WEIGHT_SAMPLES);
   }
-
-  // Select program
-  if (current_program != buttons[0].count())
+  else if (ui.manual_roast_state < ROAST && ui.selected_profile >= 0)
   {
-    FUNCTIONS[buttons[0].count()].setup();
+    snprintf(buffer, 11, "%s p%d%s", state_strings[ui.manual_roast_state], ui.selected_profile + 1,
+             ui.profile_active ? "" : " --");
   }
-  // Run Program
-  FUNCTIONS[buttons[0].count()].loop();
+  else
+  {
+    dtostrf((ui.drop_percent > 0.0) ? ui.drop_percent : 0.0, 4, 2, float_string);
+    snprintf(buffer, 10, "%s %s", state_strings[ui.manual_roast_state], float_string);
+  }
+  display.println(buffer);
+
+  // line 1: roast time, then the drop countdown while roasting, else total time
+  if (ui.manual_roast_state == ROAST && !isnan(ui.drop_countdown_s))
+  {
+    int countdown_s = (ui.drop_countdown_s < 599) ? lroundf(ui.drop_countdown_s) : 599; // one digit of minutes
+    snprintf(buffer, 11, "%01d:%02d -%01d:%02d",
+             ui.elapsed_roast_time / (60 * 1000), // Minutes
+             (ui.elapsed_roast_time / 1000) % 60, // Seconds
+             countdown_s / 60,                    // Minutes
+             countdown_s % 60                     // Seconds
+    );
+  }
+  else
+  {
+    snprintf(buffer, 11, "%01d:%02d %02d:%02d",
+             ui.elapsed_roast_time / (60 * 1000), // Minutes
+             (ui.elapsed_roast_time / 1000) % 60, // Seconds
+             ui.elapsed_total_time / (60 * 1000), // Minutes
+             (ui.elapsed_total_time / 1000) % 60  // Seconds
+    );
+  }
+  display.println(buffer);
+
+  // line 2
+  dtostrf(ui.bean_estimate_f, 4, 1, float_string);
+  snprintf(buffer, 11, "%03d %s", ui.fan_duty, float_string);
+  display.println(buffer);
+
+  // line 3: heat output, then what the heat is steered by. In manual that's
+  // the intake temperature before the roast and the rate of rise during it.
+  const char heat_mode_marks[] = {' ', '*', '^', '#', '?'};
+  float line_3 = (ui.manual_roast_state < ROAST) ? ui.intake_estimate_f : ui.bean_rate_f_per_min;
+  if (ui.heat_mode == AUTO_HEAT || ui.heat_mode == MPC_HEAT || ui.heat_mode == AUTOTUNE_HEAT)
+  {
+    line_3 = ui.setpoint_f;
+  }
+  else if (ui.heat_mode == ROR_HEAT)
+  {
+    line_3 = ui.ror_target;
+  }
+  dtostrf(line_3, 4, 1, float_string);
+  snprintf(buffer, 11, "%03d%c%s", ui.heat_output_duty, heat_mode_marks[ui.heat_mode], float_string);
+  display.println(buffer);
+
+  PROFILE_BEGIN(PHASE_DISPLAY_FLUSH);
+  TRACE_BEGIN(TRACE_DISPLAY_FLUSH);
+  display.display();
+  TRACE_END(TRACE_DISPLAY_FLUSH);
+  PROFILE_END(PHASE_DISPLAY_FLUSH);
+}
+
+// Write a csv file to serial.
+void manual_roast_telemetry()
+{
+  // Each detected charge once, ahead of the row
+  if (ui.charge_detection.count != charges_logged)
+  {
+    const ChargeDetection &charge = ui.charge_detection;
+    charges_logged = charge.count;
+    Serial.printf("# charge,g,%.1f,latency_ms,%" PRId32, charge.charge_g, charge.weight_latency_ms);
+    if (charge.dip)
+    {
+      Serial.printf(",dip,latency_ms,%" PRId32 ",offset_ms,%" PRId32 "\n", charge.dip_latency_ms, charge.dip_offset_ms);
+    }
+    else
+    {
+      Serial.println(",dip,none");
+    }
+  }
+  Serial.print(ui.elapsed_roast_time);
+  Serial.print(",");
+  Serial.print(ui.elapsed_total_time);
+  Serial.print(",");
+  Serial.print(state_strings[ui.manual_roast_state]);
+  Serial.print(",");
+  Serial.print(ui.fan_value);
+  Serial.print(",");
+  Serial.print(ui.heat_value);
+  Serial.print(",");
+  Serial.print(ui.bean_temp_f);
+  Serial.print(",");
+  Serial.print(ui.intake_temp_f);
+  Serial.print(",");
+  Serial.print(ui.weight);
+  Serial.print(",");
+  Serial.print(ui.drop_percent);
+  Serial.print(",");
+  Serial.print(heat_mode_strings[ui.heat_mode]);
+  Serial.print(",");
+  Serial.print(ui.setpoint_f);
+  Serial.print(",");
+  Serial.print(ui.heat_output_duty);
+  Serial.print(",");
+  Serial.print(ui.ror_f_per_min);
+  Serial.print(",");
+  Serial.print(ui.ror_target);
+  Serial.print(",");
+  Serial.print(ui.bean_estimate_f);
+  Serial.print(",");
+  Serial.print(ui.bean_rate_f_per_min);
+  Serial.print(",");
+  Serial.print(ui.intake_estimate_f);
+  Serial.print(",");
+  Serial.print(ui.weight_interval_g);
+  Serial.print(",");
+  Serial.print(ui.loss_percent_per_min);
+  Serial.print(",");
+  Serial.print(ui.drop_loss_s);
+  Serial.print(",");
+  Serial.print(ui.drop_end_s);
+  Serial.print(",");
+  Serial.print(ui.drop_countdown_s);
+  Serial.print(",");
+  Serial.print(ui.load_cell_counts, 0);
+  Serial.println("");
+}
+
+void read_inputs()
+{
+  // Read the filtered ADC potentiometer values
+  PROFILE_BEGIN(PHASE_POTS);
+  fan_value = pots.value(FAN_POT);
+  heat_value = pots.value(HEAT_POT);
+
+  fan_position = pot_position(*pot_tables[FAN_POT], fan_value);
+  heat_position = pot_position(*pot_tables[HEAT_POT], heat_value);
+
+  fan_duty = (fan_position * 100) / POT_FULL_SCALE;
+  heat_duty = (heat_position * 100) / POT_FULL_SCALE;
+
+  fan_dial = (fan_position * MAX_DIAL_HUNDREDTHS) / POT_FULL_SCALE;
+  heat_dial = (heat_position * MAX_DIAL_HUNDREDTHS) / POT_FULL_SCALE;
+  PROFILE_END(PHASE_POTS);
+
+  // Read the MAX6675 amplified thermocouples. The SPI peripheral clocks both
+  // chips back to back; this only queues or collects the transfers.
+  PROFILE_BEGIN(PHASE_THERMOCOUPLES);
+  int64_t now_us = esp_timer_get_time();
+  new_temperature = thermocouples.poll(now_us);
+  if (new_temperature)
+  {
+    ProbeCalibration calibrations[Max6675Bus::NUM_CHIPS];
+    taskENTER_CRITICAL(&probe_calibrations_lock);
+    memcpy(calibrations, probe_calibrations, sizeof(calibrations));
+    taskEXIT_CRITICAL(&probe_calibrations_lock);
+    float temp_f[Max6675Bus::NUM_CHIPS];
+    for (int i = 0; i < Max6675Bus::NUM_CHIPS; i++)
+    {
+      temp_f[i] = thermocouple_spikes[i].filter(calibrate(calibrations[i], thermocouples.readFarenheit(i)));
+    }
+    bean_temp_f = temp_f[BEAN_THERMOCOUPLE];
+    intake_temp_f = temp_f[INTAKE_THERMOCOUPLE];
+    bean_ror.add(bean_temp_f);
+    ror_f_per_min = bean_ror.f_per_minute();
+
+    // Until the beans are in, the bean probe is just in air
+    float model_rate = NAN;
+    if (manual_roast_state == ROAST && bean_kalman.ready() && intake_kalman.ready())
+    {
+      model_rate = mpc.bean_rate_f_per_s({intake_estimate_f, bean_estimate_f},
+                                         (float)fan_target / POT_FULL_SCALE, bean_mass_g());
+    }
+    float dt_s = (now_us - thermocouple_read_us) / 1e6;
+    thermocouple_read_us = now_us;
+    bean_kalman.update(bean_temp_f, dt_s, model_rate);
+    intake_kalman.update(intake_temp_f, dt_s);
+    bean_estimate_f = bean_kalman.leading_f(calibrations[BEAN_THERMOCOUPLE].lag_tau_s);
+    bean_rate_f_per_min = bean_kalman.rate_f_per_minute();
+    intake_estimate_f = intake_kalman.leading_f(calibrations[INTAKE_THERMOCOUPLE].lag_tau_s);
+    TRACE_SPAN(TRACE_THERMOCOUPLES, now_us);
+  }
+  PROFILE_END(PHASE_THERMOCOUPLES);
+
+  // Drain the load cell ring. The interrupt has already read every conversion.
+  PROFILE_BEGIN(PHASE_LOAD_CELL);
+  TRACE_MARK(load_cell_us);
+  new_raw = false;
+  new_weight = false;
+  load_cell_sample_count = 0;
+  if (active_load_cell_filter != load_cell_filter.load())
+  {
+    active_load_cell_filter = load_cell_filter.load();
+    load_cell_decimator.configure(DECIMATOR_SETTINGS[active_load_cell_filter]);
+    // The estimator sees the decimated noise
+    WeightNoise noise = WEIGHT_NOISE;
+    noise.reading_counts *= sqrtf(load_cell_decimator.noise_gain());
+    weights.set_noise(noise);
+  }
+  Hx711Sample sample;
+  bool pan_empty = (manual_roast_state == TARE || manual_roast_state == LOAD);
+  // At most a ring's worth a pass: the interrupt can push while this drains,
+  // and anything left waits for the next pass
+  while (load_cell_sample_count < (int)Hx711Reader::RING_SIZE && load_cell.pop(sample))
+  {
+    raw = sample.raw;
+    new_raw = true;
+    load_cell_samples[load_cell_sample_count++] = sample;
+    if (!load_cell_decimator.add(sample.raw))
+    {
+      continue;
+    }
+    new_weight = true;
+    load_cell_counts = load_cell_decimator.output();
+    float dt_s = (sample.time_us - load_cell_output_us) / 1e6;
+    load_cell_output_us = sample.time_us;
+    if (pan_empty)
+    {
+      weights.zero(load_cell_counts, intake_estimate_f, dt_s);
+    }
+    weights.weigh(load_cell_counts, intake_estimate_f, dt_s);
+  }
+  weight = weights.grams();
+  weight_interval_g = weights.interval_g();
+  if (new_raw)
+  {
+    TRACE_SPAN(TRACE_LOAD_CELL, load_cell_us);
+  }
+  PROFILE_END(PHASE_LOAD_CELL);
+}
+
+// The heartbeat and the values the supervisor checks, with test_safety's
+// injected faults
+void report_safety(int64_t now_us)
+{
+  float bean_f = bean_temp_f;
+  uint16_t heat = heat_output;
+  uint16_t fan = fan_target;
+  switch (safety_fault)
+  {
+  case (HOT_FAULT):
+    bean_f = SAFETY_LIMITS.max_bean_f + 1;
+    break;
+  case (OPEN_FAULT):
+    bean_f = NAN;
+    break;
+  case (FAN_FAULT):
+    heat = max(heat, (uint16_t)1);
+    fan = 0;
+    break;
+  default:
+    break;
+  }
+  safety.report((uint32_t)now_us, bean_f, intake_temp_f, heat, fan);
+}
+
+// The charge in the roaster. The scale is only calibrated from ROAST on.
+float bean_mass_g()
+{
+  return (manual_roast_state >= ROAST && weight > 0) ? weight : ROAST_WEIGHT_GRAMS;
+}
+
+// One MPC solve over the setpoint trajectory: the profile ahead when one is
+// being followed, otherwise the dial's setpoint held.
+void mpc_control(int64_t now_us)
+{
+  float setpoints[MpcController::HORIZON];
+  if (profile_following)
+  {
+    // A copy walks ahead from the current segment
+    ProfileCursor preview = profile_cursor;
+    for (int k = 0; k < MpcController::HORIZON; k++)
+    {
+      setpoints[k] = preview.at(elapsed_roast_time / 1000.0 + (k + 1) * MpcController::STEP_S).bean_f;
+    }
+  }
+  else
+  {
+    float target_f = MIN_SETPOINT_F + (MAX_SETPOINT_F - MIN_SETPOINT_F) * heat_position / POT_FULL_SCALE;
+    float step_f = SETPOINT_RAMP_F_PER_S * PID_DT_S;
+    setpoint_f += constrain(target_f - setpoint_f, -step_f, step_f);
+    for (int k = 0; k < MpcController::HORIZON; k++)
+    {
+      setpoints[k] = setpoint_f;
+    }
+  }
+  float fan = (float)fan_target / POT_FULL_SCALE;
+
+  int64_t start_us = esp_timer_get_time();
+  mpc_duty = mpc.solve({intake_estimate_f, bean_estimate_f}, fan, bean_mass_g(), setpoints, mpc_duty);
+  mpc_solve_us = esp_timer_get_time() - start_us;
+  mpc_solve_us_max = max(mpc_solve_us, mpc_solve_us_max);
+  heat_output = mpc_duty * POT_FULL_SCALE;
+}
+
+// Turns the heat mode into heat_output.
+// Into auto: the PID starts from the output already applied and the setpoint
+// starts at the bean temperature, then ramps to the dial, so nothing jumps.
+// Back to manual: the output holds until the dial is brought to it.
+void heat_control(int64_t now_us)
+{
+  fan_target = fan_position;
+  if (heater.tripped())
+  {
+    // The supervisor has the heater off. Start again from manual at zero.
+    heat_output = 0;
+    heat_mode = last_heat_mode = MANUAL_HEAT;
+    heat_pickup = true;
+    return;
+  }
+  bool entered = (heat_mode != last_heat_mode);
+  HEAT_MODES previous_mode = last_heat_mode;
+  last_heat_mode = heat_mode;
+
+  if (heat_mode != MANUAL_HEAT && (isnan(bean_temp_f) || (heat_mode == MPC_HEAT && isnan(intake_temp_f))))
+  {
+    // No probe, no automatic heat
+    heat_output = 0;
+    heat_mode = last_heat_mode = MANUAL_HEAT;
+    heat_pickup = true;
+    return;
+  }
+
+  bool due = entered || now_us >= next_pid_us;
+  if (due)
+  {
+    next_pid_us = (entered ? now_us : next_pid_us) + PID_PERIOD_US;
+  }
+
+  switch (heat_mode)
+  {
+  case (MANUAL_HEAT):
+    if (entered)
+    {
+      heat_pickup = (previous_mode != MANUAL_HEAT);
+    }
+    if (heat_pickup && abs(heat_position - heat_output) > HEAT_PICKUP_COUNTS)
+    {
+      break;
+    }
+    heat_pickup = false;
+    heat_output = heat_position;
+    setpoint_f = bean_estimate_f;
+    break;
+  case (AUTO_HEAT):
+    if (entered)
+    {
+      setpoint_f = bean_estimate_f;
+      pid.initialize(setpoint_f, bean_estimate_f, heat_output);
+    }
+    if (profile_following)
+    {
+      // Every pass, so the fan follows the curve smoothly between PID updates
+      ProfileSetpoint target = profile_cursor.at(elapsed_roast_time / 1000.0);
+      setpoint_f = target.bean_f;
+      if (target.fan_fraction >= 0)
+      {
+        fan_target = target.fan_fraction * POT_FULL_SCALE;
+      }
+    }
+    if (due)
+    {
+      if (!profile_following)
+      {
+        float target_f = MIN_SETPOINT_F + (MAX_SETPOINT_F - MIN_SETPOINT_F) * heat_position / POT_FULL_SCALE;
+        float step_f = SETPOINT_RAMP_F_PER_S * PID_DT_S;
+        setpoint_f += constrain(target_f - setpoint_f, -step_f, step_f);
+      }
+      heat_output = pid.update(setpoint_f, bean_estimate_f, PID_DT_S);
+    }
+    break;
+  case (ROR_HEAT):
+    if (entered)
+    {
+      ror_target = isnan(ror_f_per_min) ? 0 : ror_f_per_min;
+      ror_pid.initialize(ror_target, ror_target, heat_output);
+    }
+    if (profile_following)
+    {
+      // The curve's own slope is the target
+      ProfileSetpoint target = profile_cursor.at(elapsed_roast_time / 1000.0);
+      ror_target = target.bean_f_per_minute;
+      if (target.fan_fraction >= 0)
+      {
+        fan_target = target.fan_fraction * POT_FULL_SCALE;
+      }
+    }
+    // Until the regression window has enough samples the output holds
+    if (due && !isnan(ror_f_per_min))
+    {
+      if (!profile_following)
+      {
+        float dial_target = MAX_ROR_TARGET_F_PER_MIN * heat_position / POT_FULL_SCALE;
+        float step = ROR_TARGET_RAMP * PID_DT_S;
+        ror_target += constrain(dial_target - ror_target, -step, step);
+      }
+      heat_output = ror_pid.update(ror_target, ror_f_per_min, PID_DT_S);
+    }
+    break;
+  case (MPC_HEAT):
+    if (entered)
+    {
+      setpoint_f = bean_estimate_f;
+      mpc_duty = (float)heat_output / POT_FULL_SCALE;
+    }
+    if (profile_following)
+    {
+      ProfileSetpoint target = profile_cursor.at(elapsed_roast_time / 1000.0);
+      setpoint_f = target.bean_f;
+      if (target.fan_fraction >= 0)
+      {
+        fan_target = target.fan_fraction * POT_FULL_SCALE;
+      }
+    }
+    if (due)
+    {
+      mpc_control(now_us);
+    }
+    break;
+  case (AUTOTUNE_HEAT):
+    if (entered)
+    {
+      // Oscillate around where the roaster already is
+      setpoint_f = bean_estimate_f;
+      float bias = constrain((float)heat_output, AUTOTUNE_AMPLITUDE, POT_FULL_SCALE - AUTOTUNE_AMPLITUDE);
+      autotuner.start(setpoint_f, bias, AUTOTUNE_AMPLITUDE, AUTOTUNE_HYSTERESIS_F, now_us / 1e6, AUTOTUNE_TIMEOUT_S);
+    }
+    if (due)
+    {
+      heat_output = autotuner.update(bean_estimate_f, now_us / 1e6);
+    }
+    if (autotuner.state() == RelayAutotuner::DONE)
+    {
+      // A one-off flash write; the control task can afford the few ms, with
+      // the safety heartbeat held over it
+      ControlSettings settings = read_control_settings();
+      settings.gains = autotuner.gains();
+      write_control_settings(settings);
+      pid.set_gains(settings.gains);
+      nvs_write(PID_NVS_NAMESPACE, "gains", &settings.gains, sizeof(settings.gains));
+      heat_mode = AUTO_HEAT;
+    }
+    else if (autotuner.state() == RelayAutotuner::FAILED)
+    {
+      heat_mode = MANUAL_HEAT;
+    }
+    break;
+  }
+}
+
+void write_outputs()
+{
+  PROFILE_BEGIN(PHASE_OUTPUTS);
+  TRACE_BEGIN(TRACE_OUTPUTS);
+  // The heater timer picks the duty up at the next half-cycle.
+  // The fan registers are only written when the quantized duty changes.
+  heater.set_duty(heat_output);
+  fan_output.write(fan_target, esp_timer_get_time());
+  TRACE_END(TRACE_OUTPUTS);
+  PROFILE_END(PHASE_OUTPUTS);
+}
+
+void publish_snapshot()
+{
+  Snapshot &s = snapshots.back();
+  s.program = current_program;
+  s.fan_value = fan_value;
+  s.fan_duty = fan_duty;
+  s.fan_dial = fan_dial;
+  s.heat_value = heat_value;
+  s.heat_duty = heat_duty;
+  s.heat_dial = heat_dial;
+  s.heat_output_duty = (heat_output * 100) / POT_FULL_SCALE;
+  s.heat_mode = heat_mode;
+  s.setpoint_f = setpoint_f;
+  s.ror_f_per_min = ror_f_per_min;
+  s.ror_target = ror_target;
+  s.mpc_solve_us = mpc_solve_us;
+  s.safety_trip = safety.reason();
+  s.safety_fault = safety_fault;
+  s.mpc_solve_us_max = mpc_solve_us_max;
+  s.autotune_cycles = autotuner.cycles();
+  s.selected_profile = selected_profile;
+  s.profile_active = profile_active;
+  s.pot_sweep_point = pot_sweep_point;
+  s.pot_calibration_status = pot_calibration_status;
+  s.bean_temp_f = bean_temp_f;
+  s.intake_temp_f = intake_temp_f;
+  s.bean_estimate_f = bean_estimate_f;
+  s.bean_rate_f_per_min = bean_rate_f_per_min;
+  s.intake_estimate_f = intake_estimate_f;
+  s.raw = raw;
+  s.weight = weight;
+  s.weight_interval_g = weight_interval_g;
+  s.load_cell_counts = load_cell_counts;
+  s.load_cell_zero_counts = weights.zero_counts();
+  s.load_cell_counts_per_g = weights.counts_per_g();
+  s.load_cell_filter = active_load_cell_filter;
+  for (int i = 0; i < N_DECIMATOR_SETTINGS; i++)
+  {
+    s.load_cell_bench_outputs[i] = decimator_bench[i].outputs;
+    s.load_cell_bench_m2[i] = decimator_bench[i].m2;
+  }
+  s.load_cell_captured = load_cell.captured();
+  s.load_cell_dropped = load_cell.dropped();
+  s.load_cell_spikes = load_cell.spikes();
+  for (int i = 0; i < Max6675Bus::NUM_CHIPS; i++)
+  {
+    s.thermocouple_spikes[i] = thermocouple_spikes[i].rejected();
+  }
+  s.manual_roast_state = manual_roast_state;
+  s.drop_percent = drop_percent;
+  s.loss_percent_per_min = loss_percent_per_min;
+  s.drop_loss_s = drop_loss_s;
+  s.drop_end_s = drop_end_s;
+  s.drop_countdown_s = drop_countdown_s;
+  s.weight_samples = weight_average.count;
+  s.charge_detection = charge_detection;
+  s.elapsed_roast_time = elapsed_roast_time;
+  s.elapsed_total_time = elapsed_total_time;
+  s.control_period = control_stats.last;
+  s.control_jitter = control_jitter.last;
+  s.thermocouple_cpu_us = thermocouples.cpu_us_max();
+  s.thermocouple_transfer_us = thermocouples.transfer_us_last();
+  s.heater_half_cycles = heater.half_cycles();
+  s.heater_half_cycles_on = heater.half_cycles_on();
+  s.fan_writes_per_second = fan_output.writes_per_second();
+  s.fan_coalesced = fan_output.coalesced();
+  snapshots.publish();
+}
+
+// Runs in the esp_timer task; just releases the control task
+void control_tick(void *arg)
+{
+  xTaskNotifyGive(control_task_handle);
+}
+
+// Acquisition and control. Owns the sensors, the PWM outputs and the program
+// state machines. Nothing in here may touch the display or Serial.
+// Each tick samples the inputs, runs the program logic, then writes the
+// outputs, so every filter and controller sees a fixed sample rate.
+void control_task(void *parameter)
+{
+  for (;;)
+  {
+    uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // How far past its ideal time on the timer grid this tick started
+    int64_t now_us = esp_timer_get_time();
+    uint32_t late_us = (now_us - control_timer_start_us) % CONTROL_PERIOD_US;
+    control_jitter.record(now_us, late_us, ticks - 1);
+    control_stats.record(now_us);
+
+    apply_control_settings();
+    read_inputs();
+
+    // Select program
+    if (current_program != buttons[0].count())
+    {
+      current_program = buttons[0].count();
+      heat_mode = MANUAL_HEAT;
+      profile_following = false;
+      safety_fault = NO_FAULT;
+      FUNCTIONS[current_program].setup();
+    }
+    // Run Program
+    PROFILE_BEGIN(PHASE_PROGRAM);
+    FUNCTIONS[current_program].control();
+    heat_control(now_us);
+    PROFILE_END(PHASE_PROGRAM);
+    report_safety(now_us);
+
+    write_outputs();
+    publish_snapshot();
+  }
+}
+
+void display_job()
+{
+  PROFILE_BEGIN(PHASE_DISPLAY);
+  FUNCTIONS[ui.program].loop();
+  PROFILE_END(PHASE_DISPLAY);
+}
+
+void telemetry_job()
+{
+  PROFILE_BEGIN(PHASE_TELEMETRY);
+  TRACE_BEGIN(TRACE_TELEMETRY);
+  FUNCTIONS[ui.program].telemetry();
+  TRACE_END(TRACE_TELEMETRY);
+  PROFILE_END(PHASE_TELEMETRY);
+}
+
+// Collects a line from Serial without blocking and runs the matching command
+void command_job()
+{
+  while (Serial.available() > 0)
+  {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r')
+    {
+      if (command_length < (int)sizeof(command_line) - 1)
+      {
+        command_line[command_length++] = c;
+      }
+      continue;
+    }
+    if (command_length == 0)
+    {
+      continue;
+    }
+    command_line[command_length] = '\0';
+    command_length = 0;
+
+    char *args = strchr(command_line, ' ');
+    if (args != NULL)
+    {
+      *args++ = '\0';
+    }
+    else
+    {
+      args = command_line + strlen(command_line);
+    }
+
+    bool found = false;
+    for (int i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++)
+    {
+      if (strcmp(command_line, COMMANDS[i].name) == 0)
+      {
+        COMMANDS[i].run(args);
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      Serial.printf("# unknown command,%s\n", command_line);
+    }
+  }
+#ifdef ROASTOMATIC_TRACE
+  trace_poll();
+#endif
+}
+
+// profile        print the per-phase histograms
+// profile reset  start them over
+void profile_command(const char *args)
+{
+#ifdef ROASTOMATIC_PROFILE
+  if (strcmp(args, "reset") == 0)
+  {
+    profile_reset();
+    return;
+  }
+  profile_print();
+#else
+  Serial.println("# profile,disabled");
+#endif
+}
+
+// trace  send every trace record since the last pull, a few lines per pass
+void trace_command(const char *args)
+{
+#ifdef ROASTOMATIC_TRACE
+  trace_request();
+#else
+  Serial.println("# trace,disabled");
+#endif
+}
+
+// mains       print the mains frequency the heater is timed for
+// mains <hz>  change it (50 or 60) and keep it in NVS
+void mains_command(const char *args)
+{
+  if (*args)
+  {
+    uint32_t mains_hz = strtoul(args, NULL, 10);
+    if (mains_hz != 50 && mains_hz != 60)
+    {
+      Serial.printf("# mains,invalid,%s\n", args);
+      return;
+    }
+    heater.set_mains_frequency(mains_hz);
+    nvs_write(HEATER_NVS_NAMESPACE, "mains_hz", &mains_hz, sizeof(mains_hz));
+  }
+  Serial.printf("# mains,%" PRIu32 "\n", heater.mains_frequency());
+}
+
+// pid                    print the bean temperature gains
+// pid <kp> <ki> <kd>      change them and keep them in NVS
+// pid ror [<kp> <ki> <kd>] the same for the rate of rise loop
+void pid_command(const char *args)
+{
+  bool ror = (strncmp(args, "ror", 3) == 0);
+  const char *key = ror ? "ror_gains" : "gains";
+  args += ror ? 3 : 0;
+  while (*args == ' ')
+  {
+    args++;
+  }
+
+  ControlSettings settings = read_control_settings();
+  PidGains &gains = ror ? settings.ror_gains : settings.gains;
+  if (sscanf(args, "%f %f %f", &gains.kp, &gains.ki, &gains.kd) == 3)
+  {
+    write_control_settings(settings);
+    nvs_write(PID_NVS_NAMESPACE, key, &gains, sizeof(gains));
+  }
+  else if (*args)
+  {
+    Serial.printf("# pid,invalid,%s\n", args);
+    return;
+  }
+  Serial.printf("# pid,%s,kp,%.3f,ki,%.4f,kd,%.2f\n", ror ? "ror" : "bean", gains.kp, gains.ki, gains.kd);
+}
+
+// mpc                                     print the thermal model
+// mpc <ambient> <rise> <air tau> <bean tau> change it and keep it in NVS
+void mpc_command(const char *args)
+{
+  ThermalModel model;
+  if (sscanf(args, "%f %f %f %f", &model.ambient_f, &model.air_rise_f, &model.air_tau_s,
+             &model.bean_tau_s_per_100g) == 4 &&
+      model.air_tau_s > 0 && model.bean_tau_s_per_100g > 0)
+  {
+    ControlSettings settings = read_control_settings();
+    settings.model = model;
+    write_control_settings(settings);
+    nvs_write(PID_NVS_NAMESPACE, "model", &model, sizeof(model));
+  }
+  else if (*args)
+  {
+    Serial.printf("# mpc,invalid,%s\n", args);
+    return;
+  }
+  model = read_control_settings().model;
+  Serial.printf("# mpc,ambient_f,%.1f,air_rise_f,%.1f,air_tau_s,%.1f,bean_tau_s_per_100g,%.1f\n",
+                model.ambient_f, model.air_rise_f, model.air_tau_s, model.bean_tau_s_per_100g);
+}
+
+// safety        print the supervisor's state
+// safety reset  clear a trip, once whatever caused it has cleared
+void safety_command(const char *args)
+{
+  if (strcmp(args, "reset") == 0 && safety.reset())
+  {
+    heater.clear_trip();
+  }
+  Serial.printf("# safety,%s,trips,%" PRIu32 ",latency_us,%" PRIu32 ",max,%" PRIu32 "\n",
+                SafetySupervisor::name(safety.reason()), safety.trips(), safety.latency_us(),
+                safety.max_latency_us());
+}
+
+// probe                                      print each probe's calibration
+// probe <bean|intake> poly <c0> <c1> [c2 [c3]]  Q16 coefficients, from roastomatic.probe fit
+// probe <bean|intake> lag <tau_s>             from roastomatic.probe lag
+// probe <bean|intake> reset
+void probe_command(const char *args)
+{
+  char name[8] = "";
+  char verb[8] = "";
+  int consumed = 0;
+  sscanf(args, "%7s %7s %n", name, verb, &consumed);
+  int probe = -1;
+  for (int i = 0; i < Max6675Bus::NUM_CHIPS; i++)
+  {
+    probe = (strcmp(name, thermocouple_names[i]) == 0) ? i : probe;
+  }
+
+  if (*args)
+  {
+    ProbeCalibration calibration = PROBE_IDENTITY;
+    if (probe >= 0)
+    {
+      taskENTER_CRITICAL(&probe_calibrations_lock);
+      calibration = probe_calibrations[probe];
+      taskEXIT_CRITICAL(&probe_calibrations_lock);
+    }
+    long c[4] = {0, 0, 0, 0};
+    float tau_s = -1;
+    if (probe >= 0 && strcmp(verb, "poly") == 0 &&
+        sscanf(args + consumed, "%ld %ld %ld %ld", &c[0], &c[1], &c[2], &c[3]) >= 2)
+    {
+      for (int i = 0; i < 4; i++)
+      {
+        calibration.coefficients[i] = c[i];
+      }
+    }
+    else if (probe >= 0 && strcmp(verb, "lag") == 0 && sscanf(args + consumed, "%f", &tau_s) == 1 &&
+             tau_s >= 0 && tau_s <= MAX_PROBE_LAG_S)
+    {
+      calibration.lag_tau_s = tau_s;
+    }
+    else if (probe < 0 || strcmp(verb, "reset") != 0)
+    {
+      Serial.printf("# probe,invalid,%s\n", args);
+      return;
+    }
+    taskENTER_CRITICAL(&probe_calibrations_lock);
+    probe_calibrations[probe] = calibration;
+    taskEXIT_CRITICAL(&probe_calibrations_lock);
+    nvs_write(PROBE_NVS_NAMESPACE, thermocouple_names[probe], &calibration, sizeof(calibration));
+  }
+
+  for (int i = 0; i < Max6675Bus::NUM_CHIPS; i++)
+  {
+    taskENTER_CRITICAL(&probe_calibrations_lock);
+    ProbeCalibration calibration = probe_calibrations[i];
+    taskEXIT_CRITICAL(&probe_calibrations_lock);
+    Serial.printf("# probe,%s,poly,%" PRId32 ",%" PRId32 ",%" PRId32 ",%" PRId32 ",lag_s,%.1f\n",
+                  thermocouple_names[i], calibration.coefficients[0], calibration.coefficients[1],
+                  calibration.coefficients[2], calibration.coefficients[3], calibration.lag_tau_s);
+  }
+}
+
+// weight                                    print the zero, scale, drift and filter
+// weight drift <counts/F> <counts/F^2> <ref_F>  from roastomatic.weight
+// weight filter <n>                           decimation, compared in test_load_cell
+void weight_command(const char *args)
+{
+  LoadCellDrift drift;
+  int filter;
+  if (sscanf(args, "filter %d", &filter) == 1 && filter >= 0 && filter < N_DECIMATOR_SETTINGS)
+  {
+    load_cell_filter = filter;
+    nvs_write(LOAD_CELL_NVS_NAMESPACE, "filter", &filter, sizeof(filter));
+  }
+  else if (sscanf(args, "drift %f %f %f", &drift.counts_per_f, &drift.counts_per_f2, &drift.reference_f) == 3)
+  {
+    ControlSettings settings = read_control_settings();
+    settings.drift = drift;
+    write_control_settings(settings);
+    nvs_write(LOAD_CELL_NVS_NAMESPACE, "drift", &drift, sizeof(drift));
+  }
+  else if (*args)
+  {
+    Serial.printf("# weight,invalid,%s\n", args);
+    return;
+  }
+  drift = read_control_settings().drift;
+  filter = load_cell_filter.load();
+  Serial.printf("# weight,zero,%.0f,counts_per_g,%.2f,interval_g,%.2f,drift,%.3f,%.5f,%.1f,filter,%d,%s\n",
+                ui.load_cell_zero_counts, ui.load_cell_counts_per_g, ui.weight_interval_g,
+                drift.counts_per_f, drift.counts_per_f2, drift.reference_f,
+                filter, DECIMATOR_SETTINGS[filter].name);
+}
+
+// drop                 the targets
+// drop loss <percent>  weight loss that ends the roast, nan for none
+// drop end <F>         bean temperature that does
+void drop_command(const char *args)
+{
+  DropTargets targets;
+  taskENTER_CRITICAL(&drop_targets_lock);
+  targets = drop_targets;
+  taskEXIT_CRITICAL(&drop_targets_lock);
+  float value;
+  if (sscanf(args, "loss %f", &value) == 1 && !(value <= 0 || value >= 100))
+  {
+    targets.loss_percent = value;
+  }
+  else if (sscanf(args, "end %f", &value) == 1 && !(value <= 0))
+  {
+    targets.end_f = value;
+  }
+  else if (*args)
+  {
+    Serial.printf("# drop,invalid,%s\n", args);
+    return;
+  }
+  if (*args)
+  {
+    taskENTER_CRITICAL(&drop_targets_lock);
+    drop_targets = targets;
+    taskEXIT_CRITICAL(&drop_targets_lock);
+    nvs_write(DROP_NVS_NAMESPACE, "targets", &targets, sizeof(targets));
+  }
+  Serial.printf("# drop,loss_percent,%.1f,end_f,%.1f,countdown_s,%.0f\n",
+                targets.loss_percent, targets.end_f, ui.drop_countdown_s);
+}
+
+// roast                      list the profile slots
+// roast begin <slot> <bytes>  start an upload, built by roastomatic.profile
+// roast data <hex>            the next part of it
+// roast end                   check it and keep it in flash
+// roast erase <slot>
+void roast_command(const char *args)
+{
+  char verb[8] = "";
+  int slot = -1;
+  unsigned length = 0;
+  int offset = 0;
+  sscanf(args, "%7s %n", verb, &offset);
+  const char *rest = args + offset;
+
+  if (strcmp(verb, "begin") == 0)
+  {
+    if (sscanf(rest, "%d %u", &slot, &length) != 2 || slot < 0 || slot >= MAX_PROFILES ||
+        length > sizeof(profile_upload))
+    {
+      Serial.printf("# roast,invalid,%s\n", args);
+      return;
+    }
+    profile_upload_slot = slot;
+    profile_upload_expected = length;
+    profile_upload_length = 0;
+    Serial.printf("# roast,ready,%d\n", slot);
+    return;
+  }
+  if (strcmp(verb, "data") == 0)
+  {
+    for (; rest[0] && rest[1] && profile_upload_length < profile_upload_expected; rest += 2)
+    {
+      char hex[3] = {rest[0], rest[1], '\0'};
+      profile_upload[profile_upload_length++] = strtoul(hex, NULL, 16);
+    }
+    Serial.printf("# roast,received,%u\n", (unsigned)profile_upload_length);
+    return;
+  }
+  if (strcmp(verb, "end") == 0 || strcmp(verb, "erase") == 0)
+  {
+    bool erase = (verb[0] == 'e' && verb[1] == 'r');
+    slot = erase ? atoi(rest) : profile_upload_slot;
+    profile_upload_slot = -1;
+    if (slot < 0 || slot >= MAX_PROFILES)
+    {
+      Serial.printf("# roast,invalid,%s\n", args);
+      return;
+    }
+    static RoastProfile uploaded;
+    if (!erase && (profile_upload_length != profile_upload_expected ||
+                   !profile_load(profile_upload, profile_upload_length, uploaded)))
+    {
+      Serial.printf("# roast,rejected,%d\n", slot);
+      return;
+    }
+
+    char key[4];
+    profile_key(slot, key);
+    if (erase)
+    {
+      nvs_erase(PROFILE_NVS_NAMESPACE, key);
+    }
+    else
+    {
+      nvs_write(PROFILE_NVS_NAMESPACE, key, profile_upload, profile_upload_length);
+    }
+
+    taskENTER_CRITICAL(&profiles_lock);
+    if (!erase)
+    {
+      profiles[slot] = uploaded;
+    }
+    profile_loaded[slot] = !erase;
+    profiles_generation++;
+    taskEXIT_CRITICAL(&profiles_lock);
+    Serial.printf("# roast,%s,%d\n", erase ? "erased" : "saved", slot);
+    return;
+  }
+
+  for (slot = 0; slot < MAX_PROFILES; slot++)
+  {
+    if (profile_loaded[slot])
+    {
+      const RoastProfileHeader &header = profiles[slot].header;
+      Serial.printf("# roast,slot,%d,%.*s,points,%u,end_s,%u\n", slot, PROFILE_NAME_LENGTH, header.name,
+                    header.num_points, profiles[slot].points[header.num_points - 1].time_s);
+    }
+    else
+    {
+      Serial.printf("# roast,slot,%d,empty\n", slot);
+    }
+  }
+}
+
+void stats_job()
+{
+  // Loop periods in microseconds: min/mean/max over the last window
+  Serial.printf("# period_us,control,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",ui,%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+                ui.control_period.min_us, ui.control_period.mean_us, ui.control_period.max_us,
+                ui_stats.last.min_us, ui_stats.last.mean_us, ui_stats.last.max_us);
+  Serial.printf("# tick_jitter_us,min,%" PRIu32 ",mean,%" PRIu32 ",p99,%" PRIu32 ",max,%" PRIu32 ",missed,%" PRIu32 "\n",
+                ui.control_jitter.min_us, ui.control_jitter.mean_us, ui.control_jitter.p99_us,
+                ui.control_jitter.max_us, ui.control_jitter.missed);
+  for (int i = 0; i < ui_scheduler.num_jobs(); i++)
+  {
+    const Job &job = ui_scheduler.job(i);
+    Serial.printf("# job,%s,runs,%" PRIu32 ",overruns,%" PRIu32 ",skipped,%" PRIu32 ",max_us,%" PRIu32 "\n",
+                  job.name, job.runs, job.overruns, job.skipped, job.max_run_us);
+  }
+  Serial.printf("# load_cell,captured,%" PRIu32 ",dropped,%" PRIu32 "\n",
+                ui.load_cell_captured, ui.load_cell_dropped);
+  Serial.printf("# spikes,bean,%" PRIu32 ",intake,%" PRIu32 ",load_cell,%" PRIu32 "\n",
+                ui.thermocouple_spikes[BEAN_THERMOCOUPLE], ui.thermocouple_spikes[INTAKE_THERMOCOUPLE],
+                ui.load_cell_spikes);
+  Serial.printf("# pot_noise_lsb,fan,raw,%.2f,filtered,%.2f,heat,raw,%.2f,filtered,%.2f\n",
+                pots.raw_noise(FAN_POT), pots.filtered_noise(FAN_POT),
+                pots.raw_noise(HEAT_POT), pots.filtered_noise(HEAT_POT));
+  Serial.printf("# thermocouple_us,cpu_max,%" PRIu32 ",transfer,%" PRIu32 "\n",
+                ui.thermocouple_cpu_us, ui.thermocouple_transfer_us);
+  safety_command("");
+  Serial.printf("# mpc,solve_us,%" PRIu32 ",max,%" PRIu32 ",budget,%" PRIu32 "\n",
+                ui.mpc_solve_us, ui.mpc_solve_us_max, CONTROL_PERIOD_US);
+  Serial.printf("# outputs,heater,half_cycles,%" PRIu32 ",on,%" PRIu32 ",fan,writes_per_s,%" PRIu32 ",coalesced,%" PRIu32 "\n",
+                ui.heater_half_cycles, ui.heater_half_cycles_on, ui.fan_writes_per_second, ui.fan_coalesced);
+}
+
+// Display and telemetry. Works only from the latest snapshot.
+void ui_task(void *parameter)
+{
+  ui_scheduler.start();
+  for (;;)
+  {
+    ui_stats.record(micros());
+    ui = snapshots.read();
+
+    int64_t wait_us = ui_scheduler.run_due();
+    TickType_t wait_ticks = pdMS_TO_TICKS(wait_us / 1000);
+    vTaskDelay((wait_ticks > 0) ? wait_ticks : 1);
+  }
+}
+
+void loop()
+{
+  // Everything runs in control_task and ui_task
+  vTaskDelete(NULL);
 }
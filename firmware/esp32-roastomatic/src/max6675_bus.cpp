@@ -0,0 +1,126 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "max6675_bus.h"
+
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <math.h>
+
+// MAX6675 frame: D15 dummy, D14-D3 temperature in 0.25C, D2 open input, D1-D0 id/state
+const uint16_t MAX6675_OPEN_BIT = 0x0004;
+
+Max6675Bus::Max6675Bus(const int (&cs_pins)[NUM_CHIPS], uint32_t period_us)
+    : _period_us(period_us)
+{
+  for (int i = 0; i < NUM_CHIPS; i++)
+  {
+    _chips[i].cs_pin = cs_pins[i];
+  }
+}
+
+void Max6675Bus::begin(spi_host_device_t host, int sck_pin, int so_pin)
+{
+  spi_bus_config_t bus = {};
+  bus.mosi_io_num = -1; // The MAX6675 is read only
+  bus.miso_io_num = so_pin;
+  bus.sclk_io_num = sck_pin;
+  bus.quadwp_io_num = -1;
+  bus.quadhd_io_num = -1;
+  bus.max_transfer_sz = 4;
+  // Two byte frames fit in the transaction itself, so no DMA channel is needed
+  ESP_ERROR_CHECK(spi_bus_initialize(host, &bus, SPI_DMA_DISABLED));
+
+  for (Chip &chip : _chips)
+  {
+    spi_device_interface_config_t device = {};
+    device.mode = 0;
+    device.clock_speed_hz = CLOCK_HZ;
+    device.spics_io_num = chip.cs_pin;
+    device.queue_size = 1;
+    ESP_ERROR_CHECK(spi_bus_add_device(host, &device, &chip.device));
+
+    chip.transaction.flags = SPI_TRANS_USE_RXDATA;
+    chip.transaction.length = 16;
+    chip.transaction.rxlength = 16;
+  }
+
+  // The chips may have been interrupted by power up; give them a full conversion.
+  _next_read_us = esp_timer_get_time() + CONVERSION_US;
+}
+
+bool Max6675Bus::poll(int64_t now_us)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  if (!_in_flight)
+  {
+    if (now_us < _next_read_us)
+    {
+      return false;
+    }
+    // The driver runs queued transactions one after another on the bus
+    for (Chip &chip : _chips)
+    {
+      ESP_ERROR_CHECK(spi_device_queue_trans(chip.device, &chip.transaction, 0));
+      chip.collected = false;
+    }
+    _in_flight = true;
+    _queued_us = now_us;
+    _next_read_us = now_us + _period_us;
+    _cpu_us = esp_timer_get_time() - start_us;
+    return false;
+  }
+
+  bool all_collected = true;
+  for (Chip &chip : _chips)
+  {
+    spi_transaction_t *done;
+    if (!chip.collected && spi_device_get_trans_result(chip.device, &done, 0) == ESP_OK)
+    {
+      chip.collected = true;
+      uint16_t frame = (done->rx_data[0] << 8) | done->rx_data[1];
+      chip.open = frame & MAX6675_OPEN_BIT;
+      chip.temp_f = chip.open ? NAN : (frame >> 3) * 0.25 * 9.0 / 5.0 + 32.0;
+    }
+    all_collected = all_collected && chip.collected;
+  }
+  int64_t done_us = esp_timer_get_time();
+  _cpu_us += done_us - start_us;
+  if (!all_collected)
+  {
+    return false; // Still on the wire, try again next pass
+  }
+  _in_flight = false;
+  _transfer_us = done_us - _queued_us;
+
+  // CS going high started new conversions; don't read before they finish.
+  if (_next_read_us < done_us + CONVERSION_US)
+  {
+    _next_read_us = done_us + CONVERSION_US;
+  }
+
+  _reads++;
+  _cpu_us_max = (_cpu_us > _cpu_us_max) ? _cpu_us : _cpu_us_max;
+  return true;
+}
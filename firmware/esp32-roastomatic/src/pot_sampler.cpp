@@ -0,0 +1,160 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "pot_sampler.h"
+
+#include <esp_attr.h>
+#include <esp_err.h>
+#include <math.h>
+
+const int POT_TASK_STACK = 3072;
+
+PotSampler::PotSampler(const int pins[NUM_POTS])
+{
+  for (int i = 0; i < NUM_POTS; i++)
+  {
+    _pins[i] = pins[i];
+    _value[i].store(0);
+  }
+}
+
+void PotSampler::begin(int core, int priority)
+{
+  adc_continuous_handle_cfg_t handle_config = {};
+  handle_config.max_store_buf_size = 4 * FRAME_BYTES;
+  handle_config.conv_frame_size = FRAME_BYTES;
+  ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_config, &_handle));
+
+  adc_digi_pattern_config_t patterns[NUM_POTS] = {};
+  for (int i = 0; i < NUM_POTS; i++)
+  {
+    adc_unit_t unit;
+    ESP_ERROR_CHECK(adc_continuous_io_to_channel(_pins[i], &unit, &_channels[i]));
+    patterns[i].atten = ADC_ATTEN_DB_11; // Same full scale as analogRead()
+    patterns[i].channel = _channels[i];
+    patterns[i].unit = ADC_UNIT_1;
+    patterns[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_continuous_config_t config = {};
+  config.pattern_num = NUM_POTS;
+  config.adc_pattern = patterns;
+  config.sample_freq_hz = SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  ESP_ERROR_CHECK(adc_continuous_config(_handle, &config));
+
+  xTaskCreatePinnedToCore(task, "pots", POT_TASK_STACK, this, priority, &_task, core);
+
+  adc_continuous_evt_cbs_t callbacks = {};
+  callbacks.on_conv_done = on_frame;
+  ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(_handle, &callbacks, this));
+  ESP_ERROR_CHECK(adc_continuous_start(_handle));
+}
+
+// Interrupt context: just wake the task
+bool IRAM_ATTR PotSampler::on_frame(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *data, void *arg)
+{
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(((PotSampler *)arg)->_task, &woken);
+  return woken == pdTRUE;
+}
+
+void PotSampler::task(void *arg)
+{
+  PotSampler *self = (PotSampler *)arg;
+  uint8_t frame[FRAME_BYTES];
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t length = 0;
+    while (adc_continuous_read(self->_handle, frame, FRAME_BYTES, &length, 0) == ESP_OK)
+    {
+      self->process(frame, length);
+    }
+  }
+}
+
+// Stage one: average every conversion of each pot in the frame
+void PotSampler::process(const uint8_t *frame, uint32_t length)
+{
+  int64_t sum[NUM_POTS] = {};
+  int64_t square_sum[NUM_POTS] = {};
+  int32_t count[NUM_POTS] = {};
+
+  for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES)
+  {
+    const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&frame[i];
+    for (int pot = 0; pot < NUM_POTS; pot++)
+    {
+      if (result->type1.channel == _channels[pot])
+      {
+        int32_t data = result->type1.data;
+        sum[pot] += data;
+        square_sum[pot] += data * data;
+        count[pot]++;
+      }
+    }
+  }
+
+  for (int pot = 0; pot < NUM_POTS; pot++)
+  {
+    if (count[pot] < 2)
+    {
+      return;
+    }
+  }
+
+  for (int pot = 0; pot < NUM_POTS; pot++)
+  {
+    double mean = (double)sum[pot] / count[pot];
+    _raw_variance_sum[pot] += (double)square_sum[pot] / count[pot] - mean * mean;
+    publish(pot, (sum[pot] + count[pot] / 2) / count[pot]);
+  }
+  _smooth_index = (_smooth_index + 1) % SMOOTH_LENGTH;
+
+  if (++_noise_count == NOISE_WINDOW)
+  {
+    for (int pot = 0; pot < NUM_POTS; pot++)
+    {
+      double mean = _filtered_sum[pot] / _noise_count;
+      _raw_noise[pot] = sqrt(_raw_variance_sum[pot] / _noise_count);
+      _filtered_noise[pot] = sqrt(fmax(_filtered_square_sum[pot] / _noise_count - mean * mean, 0.0));
+      _raw_variance_sum[pot] = 0;
+      _filtered_sum[pot] = 0;
+      _filtered_square_sum[pot] = 0;
+    }
+    _noise_count = 0;
+  }
+}
+
+// Stage two: moving average across frames
+void PotSampler::publish(int pot, int32_t decimated)
+{
+  _smooth_sum[pot] += decimated - _smooth[pot][_smooth_index];
+  _smooth[pot][_smooth_index] = decimated;
+  float filtered = (float)_smooth_sum[pot] / SMOOTH_LENGTH;
+
+  _filtered_sum[pot] += filtered;
+  _filtered_square_sum[pot] += filtered * filtered;
+  _value[pot].store(lroundf(filtered), std::memory_order_relaxed);
+}
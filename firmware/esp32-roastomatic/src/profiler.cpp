@@ -0,0 +1,72 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "profiler.h"
+
+#ifdef ROASTOMATIC_PROFILE
+
+#include <Arduino.h>
+#include <inttypes.h>
+#include <string.h>
+
+const char *PHASE_NAMES[NUM_PHASES] = {
+    "pots",
+    "thermocouples",
+    "load_cell",
+    "program",
+    "outputs",
+    "display",
+    "display_flush",
+    "telemetry",
+};
+
+PhaseProfile phase_profiles[NUM_PHASES];
+
+// One line per phase:
+// # profile,<phase>,count,<n>,mean_us,<us>,max_us,<us>,hist,<bucket>:<n>;...
+// Histogram buckets are log2 of the cycle count; empty ones are left out.
+void profile_print()
+{
+  uint32_t mhz = getCpuFrequencyMhz();
+  for (int i = 0; i < NUM_PHASES; i++)
+  {
+    const PhaseProfile &p = phase_profiles[i];
+    uint32_t mean = (p.count > 0) ? p.total_cycles / p.count : 0;
+    Serial.printf("# profile,%s,count,%" PRIu32 ",mean_us,%.1f,max_us,%.1f,hist,",
+                  PHASE_NAMES[i], p.count, (float)mean / mhz, (float)p.max_cycles / mhz);
+    for (int b = 0; b < PROFILE_BUCKETS; b++)
+    {
+      if (p.buckets[b] > 0)
+      {
+        Serial.printf("%d:%" PRIu32 ";", b, p.buckets[b]);
+      }
+    }
+    Serial.println();
+  }
+}
+
+void profile_reset()
+{
+  memset(phase_profiles, 0, sizeof(phase_profiles));
+}
+
+#endif
@@ -0,0 +1,88 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "ssr_heater.h"
+
+#include <esp_attr.h>
+#include <esp_err.h>
+#include <soc/gpio_reg.h>
+
+#include <Arduino.h>
+
+const uint32_t TIMER_RESOLUTION_HZ = 1000000; // 1us ticks
+
+SsrHeater::SsrHeater(int pin, uint16_t full_scale)
+    : _pin(pin), _modulator(full_scale) {}
+
+void SsrHeater::begin(uint32_t mains_hz)
+{
+  pinMode(_pin, OUTPUT);
+  digitalWrite(_pin, LOW);
+
+  gptimer_config_t config = {};
+  config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+  config.direction = GPTIMER_COUNT_UP;
+  config.resolution_hz = TIMER_RESOLUTION_HZ;
+  ESP_ERROR_CHECK(gptimer_new_timer(&config, &_timer));
+
+  gptimer_event_callbacks_t callbacks = {};
+  callbacks.on_alarm = on_alarm;
+  ESP_ERROR_CHECK(gptimer_register_event_callbacks(_timer, &callbacks, this));
+  ESP_ERROR_CHECK(gptimer_enable(_timer));
+
+  set_mains_frequency(mains_hz);
+  ESP_ERROR_CHECK(gptimer_start(_timer));
+}
+
+void SsrHeater::set_mains_frequency(uint32_t mains_hz)
+{
+  _mains_hz = mains_hz;
+  gptimer_alarm_config_t alarm = {};
+  alarm.alarm_count = HeaterModulator::half_cycle_us(mains_hz);
+  alarm.reload_count = 0;
+  alarm.flags.auto_reload_on_alarm = true;
+  ESP_ERROR_CHECK(gptimer_set_alarm_action(_timer, &alarm));
+}
+
+void IRAM_ATTR SsrHeater::trip()
+{
+  _tripped.store(true);
+  REG_WRITE(GPIO_OUT_W1TC_REG, 1UL << _pin);
+}
+
+bool IRAM_ATTR SsrHeater::on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *event, void *arg)
+{
+  SsrHeater *self = (SsrHeater *)arg;
+  // Pins 0-31 only, which covers every output on this board
+  uint32_t mask = 1UL << self->_pin;
+  bool on = self->_modulator.next_half_cycle();
+  if (on && !self->_tripped.load())
+  {
+    REG_WRITE(GPIO_OUT_W1TS_REG, mask);
+  }
+  else
+  {
+    REG_WRITE(GPIO_OUT_W1TC_REG, mask);
+  }
+  return false; // nothing woken
+}
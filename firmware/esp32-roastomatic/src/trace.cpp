@@ -0,0 +1,181 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "trace.h"
+
+#ifdef ROASTOMATIC_TRACE
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+const char *TRACE_EVENT_NAMES[NUM_TRACE_EVENTS] = {
+    "thermocouples",
+    "load_cell",
+    "outputs",
+    "display_flush",
+    "telemetry",
+    "state",
+};
+
+// A writer on each core may have claimed a slot it hasn't filled yet,
+// so the newest records wait for the next pull.
+const uint32_t TRACE_WRITERS = 2;
+
+// A pull is sent a few lines per command pass, and only while the serial
+// transmit buffer has room for them, so it never holds up the UI task and
+// telemetry still gets through. Two 48 byte lines every 20ms is about
+// three times the busiest record rate.
+const int TRACE_LINES_PER_POLL = 2;
+const int TRACE_LINE_BYTES = 48;                                // packed records, 64 characters of base64
+const int TRACE_LINE_LENGTH = 8 + 4 * TRACE_LINE_BYTES / 3 + 2; // "# trace," ... "\r\n"
+const int TRACE_MAX_PACKED = 1 + 4 + 1;                         // flags, wide time, arg
+
+TraceRecord trace_ring[TRACE_RECORDS];
+std::atomic<uint32_t> trace_head{0};
+uint32_t trace_tail = 0;
+uint32_t trace_end = 0;
+bool trace_pulling = false;
+uint32_t trace_last_time = 0;
+bool trace_wide = true; // the next record carries its full time stamp
+
+// Records are packed, and usually take 3 bytes:
+//   flags  event (bits 0-3), phase (4-5: 0 'B', 1 'E', 2 'i'), core (6), wide (7)
+//   time   int16 microseconds since the previous record, or uint32 when wide
+//   arg    instants only
+int trace_pack(const TraceRecord &r, uint8_t *out)
+{
+  int32_t delta = r.time_us - trace_last_time;
+  bool wide = trace_wide || delta < INT16_MIN || delta > INT16_MAX;
+  uint8_t phase = (r.phase == 'B') ? 0 : (r.phase == 'E') ? 1 : 2;
+  int n = 0;
+  out[n++] = r.event | (phase << 4) | (r.core << 6) | (wide << 7);
+  uint32_t time = wide ? r.time_us : (uint32_t)delta;
+  for (int b = 0; b < (wide ? 4 : 2); b++)
+  {
+    out[n++] = time >> (8 * b);
+  }
+  if (phase == 2)
+  {
+    out[n++] = r.arg;
+  }
+  trace_last_time = r.time_us;
+  trace_wide = false;
+  return n;
+}
+
+// Returns the length written to out, which needs room for 4 * ceil(n / 3) + 1
+int base64_encode(const uint8_t *in, int n, char *out)
+{
+  static const char DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char *c = out;
+  for (int i = 0; i < n; i += 3)
+  {
+    uint32_t group = in[i] << 16 | ((i + 1 < n) ? in[i + 1] << 8 : 0) | ((i + 2 < n) ? in[i + 2] : 0);
+    *c++ = DIGITS[(group >> 18) & 0x3f];
+    *c++ = DIGITS[(group >> 12) & 0x3f];
+    *c++ = (i + 1 < n) ? DIGITS[(group >> 6) & 0x3f] : '=';
+    *c++ = (i + 2 < n) ? DIGITS[group & 0x3f] : '=';
+  }
+  *c = '\0';
+  return c - out;
+}
+
+// Skips past records the ring has overwritten, returning how many were lost
+uint32_t trace_skip_lapped(uint32_t head)
+{
+  uint32_t pending = head - trace_tail;
+  if (pending <= TRACE_RECORDS - TRACE_WRITERS)
+  {
+    return 0;
+  }
+  uint32_t dropped = pending - (TRACE_RECORDS - TRACE_WRITERS);
+  trace_tail += dropped;
+  trace_wide = true;
+  return dropped;
+}
+
+// # trace,begin,<records>,dropped,<n>
+// # trace,names,<event 0>,<event 1>,...
+// # trace,<base64 packed records>
+// # trace,dropped,<n>        (if the ring laps a pull that is still being sent)
+// # trace,end
+void trace_request()
+{
+  if (trace_pulling)
+  {
+    return; // the host asks again once this one has ended
+  }
+  uint32_t head = trace_head.load(std::memory_order_acquire);
+  uint32_t dropped = trace_skip_lapped(head);
+  trace_end = (head - trace_tail > TRACE_WRITERS) ? head - TRACE_WRITERS : trace_tail;
+  trace_pulling = true;
+  trace_wide = true;
+
+  Serial.printf("# trace,begin,%" PRIu32 ",dropped,%" PRIu32 "\n", trace_end - trace_tail, dropped);
+  Serial.print("# trace,names");
+  for (int i = 0; i < NUM_TRACE_EVENTS; i++)
+  {
+    Serial.printf(",%s", TRACE_EVENT_NAMES[i]);
+  }
+  Serial.println();
+}
+
+void trace_poll()
+{
+  if (!trace_pulling)
+  {
+    return;
+  }
+  uint32_t dropped = trace_skip_lapped(trace_head.load(std::memory_order_acquire));
+  if (dropped)
+  {
+    if ((int32_t)(trace_end - trace_tail) < 0)
+    {
+      trace_end = trace_tail;
+    }
+    Serial.printf("# trace,dropped,%" PRIu32 "\n", dropped);
+  }
+
+  uint8_t packed[TRACE_LINE_BYTES];
+  char line[TRACE_LINE_LENGTH] = "# trace,";
+  for (int lines = 0; lines < TRACE_LINES_PER_POLL && trace_tail != trace_end; lines++)
+  {
+    if (Serial.availableForWrite() < TRACE_LINE_LENGTH)
+    {
+      return;
+    }
+    int n = 0;
+    while (trace_tail != trace_end && n <= TRACE_LINE_BYTES - TRACE_MAX_PACKED)
+    {
+      n += trace_pack(trace_ring[trace_tail++ & (TRACE_RECORDS - 1)], packed + n);
+    }
+    base64_encode(packed, n, line + 8);
+    Serial.println(line);
+  }
+  if (trace_tail == trace_end)
+  {
+    Serial.println("# trace,end");
+    trace_pulling = false;
+  }
+}
+
+#endif
@@ -0,0 +1,91 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include "cusum.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+// Uniform noise with the given standard deviation
+float noise(float sigma)
+{
+  return sigma * 1.7320508f * (2.0f * rand() / RAND_MAX - 1.0f);
+}
+
+void test_noise_alone_never_alarms()
+{
+  srand(1);
+  Cusum cusum(2.0, 10.0);
+  for (int i = 0; i < 100000; i++)
+  {
+    TEST_ASSERT_FALSE(cusum.add(noise(1.0), i));
+  }
+  TEST_ASSERT_FALSE(cusum.alarmed());
+}
+
+void test_a_step_is_dated_where_it_began()
+{
+  srand(2);
+  Cusum cusum(2.0, 10.0);
+  int alarm = -1;
+  for (int i = 0; i < 200; i++)
+  {
+    float step = (i >= 100) ? 5.0 : 0.0;
+    if (cusum.add(step + noise(0.1), i * 1000))
+    {
+      alarm = i;
+    }
+  }
+  // (5 - 2) a sample climbs past 10 on the fourth
+  TEST_ASSERT_EQUAL(103, alarm);
+  TEST_ASSERT_EQUAL(100000, cusum.change_us());
+  TEST_ASSERT_EQUAL(3000, cusum.latency_us());
+}
+
+void test_latches_until_reset()
+{
+  Cusum cusum(1.0, 2.0);
+  TEST_ASSERT_TRUE(cusum.add(4.0, 1));
+  TEST_ASSERT_FALSE(cusum.add(4.0, 2));
+  TEST_ASSERT_TRUE(cusum.alarmed());
+  cusum.reset();
+  TEST_ASSERT_FALSE(cusum.alarmed());
+  TEST_ASSERT_FALSE(cusum.add(NAN, 3));
+  TEST_ASSERT_FALSE(cusum.add(2.0, 4));
+  TEST_ASSERT_TRUE(cusum.add(2.0, 5));
+  TEST_ASSERT_EQUAL(4, cusum.change_us());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_noise_alone_never_alarms);
+  RUN_TEST(test_a_step_is_dated_where_it_began);
+  RUN_TEST(test_latches_until_reset);
+  return UNITY_END();
+}
@@ -0,0 +1,122 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include "decimator.h"
+
+const DecimatorSettings SETTINGS[] = {
+    {"box/4", 1, 4, false},
+    {"cic3/8", 3, 8, false},
+    {"cic3/4+hb", 3, 4, true},
+    {"cic4/16+hb", 4, 16, true},
+};
+const int N_SETTINGS = sizeof(SETTINGS) / sizeof(SETTINGS[0]);
+Decimator decimator;
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_passes_a_constant()
+{
+  for (const DecimatorSettings &settings : SETTINGS)
+  {
+    decimator.configure(settings);
+    int outputs = 0;
+    for (int i = 0; i < 2000; i++)
+    {
+      if (decimator.add(-8000000)) // near the bottom of the HX711's range
+      {
+        outputs++;
+        TEST_ASSERT_FLOAT_WITHIN(1.0, -8000000, decimator.output());
+      }
+    }
+    TEST_ASSERT_INT_WITHIN(1 + (int)decimator.group_delay() * 2 / decimator.decimation(),
+                           2000 / decimator.decimation(), outputs);
+  }
+}
+
+void test_ramp_lags_by_the_group_delay()
+{
+  for (const DecimatorSettings &settings : SETTINGS)
+  {
+    decimator.configure(settings);
+    for (int i = 0; i < 3000; i++)
+    {
+      if (decimator.add(100000 + 7 * i))
+      {
+        TEST_ASSERT_FLOAT_WITHIN(0.05, 100000 + 7 * (i - decimator.group_delay()), decimator.output());
+      }
+    }
+  }
+}
+
+void test_noise_gain_matches_white_noise()
+{
+  for (const DecimatorSettings &settings : SETTINGS)
+  {
+    decimator.configure(settings);
+    srand(1);
+    double sum = 0, sum2 = 0;
+    int n = 0;
+    for (int i = 0; i < 400000; i++)
+    {
+      if (decimator.add((rand() % 2001) - 1000))
+      {
+        sum += decimator.output();
+        sum2 += decimator.output() * decimator.output();
+        n++;
+      }
+    }
+    double input_variance = 1000.0 * 1002 / 3; // uniform on [-1000, 1000]
+    double variance = sum2 / n - (sum / n) * (sum / n);
+    TEST_ASSERT_FLOAT_WITHIN(0.1 * decimator.noise_gain(), decimator.noise_gain(), variance / input_variance);
+  }
+  decimator.configure(SETTINGS[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.25, decimator.noise_gain());
+}
+
+void test_integrators_wrap_safely()
+{
+  decimator.configure(SETTINGS[3]);
+  for (int i = 0; i < 200000; i++) // long past overflowing 2^44 of integrator growth
+  {
+    if (decimator.add(8000000))
+    {
+      TEST_ASSERT_FLOAT_WITHIN(1.0, 8000000, decimator.output());
+    }
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_passes_a_constant);
+  RUN_TEST(test_ramp_lags_by_the_group_delay);
+  RUN_TEST(test_noise_gain_matches_white_noise);
+  RUN_TEST(test_integrators_wrap_safely);
+  return UNITY_END();
+}
@@ -0,0 +1,107 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "drop_predictor.h"
+
+const int WINDOW = 60;
+const float CONTROL_DT_S = 0.01;
+
+void setUp() {}
+
+void tearDown() {}
+
+// Weight falling 1.5 g/min from 90 g, bean at 350F rising at 20F/min with
+// that falling 2F/min every minute, for two minutes of control passes
+void run(DropPredictor<WINDOW> &predictor, float ror_change = -2)
+{
+  predictor.reset(90);
+  float t = 0;
+  for (int i = 0; i <= 12000; i++)
+  {
+    t = i * CONTROL_DT_S;
+    float minutes = t / 60 - 2;
+    float ror = 20 + ror_change * minutes;
+    float bean_f = 350 + 20 * minutes + 0.5 * ror_change * minutes * minutes;
+    predictor.update(90 - 1.5 * t / 60, bean_f, ror, CONTROL_DT_S);
+  }
+}
+
+void test_weight_countdown()
+{
+  DropPredictor<WINDOW> predictor(1.0);
+  run(predictor);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1.5 * 100 / 90, predictor.loss_percent_per_min());
+  // 87 g now, 76.5 g at 15%
+  TEST_ASSERT_FLOAT_WITHIN(2, 420, predictor.seconds_to_loss(15));
+  TEST_ASSERT_EQUAL(0, predictor.seconds_to_loss(2));
+}
+
+void test_temperature_countdown_follows_the_falling_ror()
+{
+  DropPredictor<WINDOW> predictor(1.0);
+  run(predictor);
+  // 50F more at 20F/min less 2F/min a minute: 10 - sqrt(50) minutes
+  TEST_ASSERT_FLOAT_WITHIN(1, 175.7, predictor.seconds_to_temperature(400));
+  // The rate of rise runs out at 450F
+  TEST_ASSERT_TRUE(isnan(predictor.seconds_to_temperature(460)));
+  TEST_ASSERT_EQUAL(0, predictor.seconds_to_temperature(340));
+}
+
+void test_a_rising_ror_is_held_not_extrapolated()
+{
+  DropPredictor<WINDOW> predictor(1.0);
+  run(predictor, 2);
+  TEST_ASSERT_FLOAT_WITHIN(1, 150, predictor.seconds_to_temperature(400));
+}
+
+void test_sooner_target_wins()
+{
+  DropPredictor<WINDOW> predictor(1.0);
+  run(predictor);
+  TEST_ASSERT_FLOAT_WITHIN(1, 175.7, predictor.seconds_remaining({15, 400}));
+  TEST_ASSERT_FLOAT_WITHIN(2, 420, predictor.seconds_remaining({15, 460}));
+  TEST_ASSERT_FLOAT_WITHIN(2, 420, predictor.seconds_remaining({15, NAN}));
+  TEST_ASSERT_TRUE(isnan(predictor.seconds_remaining({NAN, NAN})));
+}
+
+void test_nothing_until_the_trends_fill()
+{
+  DropPredictor<WINDOW> predictor(1.0);
+  predictor.reset(90);
+  predictor.update(90, 300, 20, CONTROL_DT_S);
+  TEST_ASSERT_TRUE(isnan(predictor.loss_percent_per_min()));
+  TEST_ASSERT_TRUE(isnan(predictor.seconds_to_loss(15)));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_weight_countdown);
+  RUN_TEST(test_temperature_countdown_follows_the_falling_ror);
+  RUN_TEST(test_a_rising_ror_is_held_not_extrapolated);
+  RUN_TEST(test_sooner_target_wins);
+  RUN_TEST(test_nothing_until_the_trends_fill);
+  return UNITY_END();
+}
@@ -0,0 +1,141 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include <algorithm>
+#include <stdlib.h>
+
+#include "hampel_filter.h"
+
+const int WINDOW = 7;
+
+void setUp() {}
+
+void tearDown() {}
+
+// The filter's answer worked out the slow way
+float brute_force(const float *history, float threshold, float min_scale, bool mad)
+{
+  float sorted[WINDOW];
+  std::copy(history, history + WINDOW, sorted);
+  std::sort(sorted, sorted + WINDOW);
+  float median = sorted[WINDOW / 2];
+  float scale;
+  if (mad)
+  {
+    float distances[WINDOW];
+    for (int i = 0; i < WINDOW; i++)
+    {
+      distances[i] = fabsf(sorted[i] - median);
+    }
+    std::sort(distances, distances + WINDOW);
+    scale = 1.4826f * distances[WINDOW / 2];
+  }
+  else
+  {
+    scale = (sorted[3 * WINDOW / 4] - sorted[WINDOW / 4]) / 1.349f;
+  }
+  scale = std::max(scale, min_scale);
+  float x = history[WINDOW - 1];
+  return (fabsf(x - median) > threshold * scale) ? median : x;
+}
+
+void check_against_brute_force(HampelFilter<WINDOW>::Scale scale)
+{
+  HampelFilter<WINDOW> hampel(3.0, 0.5, scale);
+  float history[WINDOW];
+  srand(1);
+  for (int i = 0; i < 5000; i++)
+  {
+    // Coarse values so there are plenty of ties, and some spikes
+    float x = (rand() % 20) * 0.45f + ((rand() % 10 == 0) ? 40.0f : 0.0f);
+    std::copy(history + 1, history + WINDOW, history);
+    history[WINDOW - 1] = x;
+    float filtered = hampel.filter(x);
+    if (i >= WINDOW - 1)
+    {
+      TEST_ASSERT_FLOAT_WITHIN(1e-4, brute_force(history, 3.0, 0.5, scale == HampelFilter<WINDOW>::MAD), filtered);
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(0, hampel.rejected());
+}
+
+void test_iqr_matches_brute_force() { check_against_brute_force(HampelFilter<WINDOW>::IQR); }
+
+void test_mad_matches_brute_force() { check_against_brute_force(HampelFilter<WINDOW>::MAD); }
+
+void test_rejects_a_spike_and_accepts_a_step()
+{
+  HampelFilter<WINDOW> hampel(3.0, 0.45);
+  for (int i = 0; i < 20; i++)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 300, hampel.filter(300));
+  }
+  // One bean knocks the probe
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 300, hampel.filter(340));
+  TEST_ASSERT_EQUAL(1, hampel.rejected());
+  // A real move to 320 shows up within half the window
+  int accepted_at = -1;
+  for (int i = 0; i < WINDOW; i++)
+  {
+    if (hampel.filter(320) == 320 && accepted_at < 0)
+    {
+      accepted_at = i;
+    }
+  }
+  TEST_ASSERT_EQUAL(WINDOW / 2 - 1, accepted_at);
+}
+
+void test_quiet_signal_keeps_its_next_count()
+{
+  HampelFilter<WINDOW> hampel(3.0, 0.45);
+  for (int i = 0; i < 20; i++)
+  {
+    hampel.filter(300);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 300.45, hampel.filter(300.45));
+  TEST_ASSERT_EQUAL(0, hampel.rejected());
+}
+
+void test_nan_passes_through()
+{
+  HampelFilter<WINDOW> hampel(3.0, 0.45);
+  for (int i = 0; i < 20; i++)
+  {
+    hampel.filter(300);
+  }
+  TEST_ASSERT_TRUE(isnan(hampel.filter(NAN)));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 300, hampel.filter(340));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_iqr_matches_brute_force);
+  RUN_TEST(test_mad_matches_brute_force);
+  RUN_TEST(test_rejects_a_spike_and_accepts_a_step);
+  RUN_TEST(test_quiet_signal_keeps_its_next_count);
+  RUN_TEST(test_nan_passes_through);
+  return UNITY_END();
+}
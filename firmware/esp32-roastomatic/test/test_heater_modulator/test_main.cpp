@@ -0,0 +1,144 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "heater_modulator.h"
+
+// Simulated mains: steps time one half-cycle at a time and records what the
+// modulator asked the SSR to do, the way the timer does on the device.
+const uint32_t MAINS_HZ = 60;
+const uint16_t FULL_SCALE = 4095;
+const int MAX_HALF_CYCLES = 4 * FULL_SCALE;
+
+HeaterModulator modulator(FULL_SCALE);
+bool ssr[MAX_HALF_CYCLES];
+uint64_t now_us;
+
+void run_mains(int half_cycles)
+{
+  for (int i = 0; i < half_cycles; i++)
+  {
+    ssr[i] = modulator.next_half_cycle();
+    now_us += HeaterModulator::half_cycle_us(MAINS_HZ);
+  }
+}
+
+int count_on(int start, int length)
+{
+  int on = 0;
+  for (int i = start; i < start + length; i++)
+  {
+    on += ssr[i];
+  }
+  return on;
+}
+
+void setUp()
+{
+  modulator.reset();
+  now_us = 0;
+}
+
+void tearDown() {}
+
+void test_half_cycle_period()
+{
+  TEST_ASSERT_EQUAL(8333, HeaterModulator::half_cycle_us(60));
+  TEST_ASSERT_EQUAL(10000, HeaterModulator::half_cycle_us(50));
+}
+
+void test_off_and_full_scale()
+{
+  modulator.set_duty(0);
+  run_mains(1000);
+  TEST_ASSERT_EQUAL(0, count_on(0, 1000));
+
+  modulator.set_duty(FULL_SCALE);
+  run_mains(1000);
+  TEST_ASSERT_EQUAL(1000, count_on(0, 1000));
+
+  modulator.set_duty(FULL_SCALE + 100); // clamped
+  TEST_ASSERT_EQUAL(FULL_SCALE, modulator.duty());
+}
+
+void test_exact_power_over_full_scale()
+{
+  const uint16_t duties[] = {1, 7, 1000, 2048, 3333, 4094};
+  for (uint16_t duty : duties)
+  {
+    setUp();
+    modulator.set_duty(duty);
+    run_mains(FULL_SCALE);
+    TEST_ASSERT_EQUAL(duty, count_on(0, FULL_SCALE));
+    TEST_ASSERT_EQUAL(duty, modulator.half_cycles_on());
+  }
+}
+
+void test_every_window_within_one_half_cycle()
+{
+  // Sliding one second windows never stray more than one half-cycle from ideal
+  const int window = 2 * MAINS_HZ;
+  const uint16_t duties[] = {10, 410, 1365, 2047, 3000};
+  for (uint16_t duty : duties)
+  {
+    setUp();
+    modulator.set_duty(duty);
+    run_mains(MAX_HALF_CYCLES);
+    double ideal = (double)duty * window / FULL_SCALE;
+    for (int start = 0; start + window <= MAX_HALF_CYCLES; start++)
+    {
+      TEST_ASSERT_FLOAT_WITHIN(1.0, ideal, count_on(start, window));
+    }
+  }
+}
+
+void test_half_power_alternates()
+{
+  modulator.set_duty(FULL_SCALE / 2 + 1);
+  run_mains(100);
+  for (int i = 1; i < 100; i++)
+  {
+    TEST_ASSERT_TRUE(ssr[i] != ssr[i - 1]);
+  }
+}
+
+void test_duty_change_takes_effect_next_half_cycle()
+{
+  modulator.set_duty(0);
+  run_mains(10);
+  modulator.set_duty(FULL_SCALE);
+  TEST_ASSERT_TRUE(modulator.next_half_cycle());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_half_cycle_period);
+  RUN_TEST(test_off_and_full_scale);
+  RUN_TEST(test_exact_power_over_full_scale);
+  RUN_TEST(test_every_window_within_one_half_cycle);
+  RUN_TEST(test_half_power_alternates);
+  RUN_TEST(test_duty_change_takes_effect_next_half_cycle);
+  return UNITY_END();
+}
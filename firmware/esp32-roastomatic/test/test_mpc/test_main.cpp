@@ -0,0 +1,128 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include <chrono>
+
+#include "mpc.h"
+
+const ThermalModel MODEL = {70, 300, 20, 120};
+const float MOVE_PENALTY = 2e4;
+const float FAN = 0.6;
+const float MASS_G = 90;
+
+MpcController mpc(MODEL, MOVE_PENALTY);
+float setpoints[MpcController::HORIZON];
+
+void hold(float setpoint_f)
+{
+  for (int k = 0; k < MpcController::HORIZON; k++)
+  {
+    setpoints[k] = setpoint_f;
+  }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_duty_in_bounds_and_saturates_when_far_below()
+{
+  hold(450);
+  float duty = mpc.solve({70, 70}, FAN, MASS_G, setpoints, 0);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.0, duty);
+  hold(70);
+  duty = mpc.solve({400, 400}, FAN, MASS_G, setpoints, 1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, duty);
+}
+
+// A heater with no effect and no move penalty leaves nothing to solve
+void test_singular_holds_the_previous_duty()
+{
+  MpcController dead({70, 0, 20, 120}, 0);
+  hold(350);
+  float duty = dead.solve({200, 200}, FAN, MASS_G, setpoints, 0.4);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.4, duty);
+  duty = dead.solve({200, 200}, FAN, MASS_G, setpoints, 1.5);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 1.0, duty);
+}
+
+// Closed loop against the model itself, one solve per model step
+void test_tracks_a_step_without_overshoot()
+{
+  hold(350);
+  float duty = 0;
+  float peak = 0;
+  ThermalState state = {200, 200};
+  for (int t = 0; t < 600; t++)
+  {
+    duty = mpc.solve(state, FAN, MASS_G, setpoints, duty);
+    TEST_ASSERT_TRUE(duty >= 0 && duty <= 1);
+    state = mpc.step(state, duty, FAN, MASS_G);
+    peak = fmaxf(peak, state.bean_f);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 350, state.bean_f);
+  TEST_ASSERT_LESS_THAN(353, peak);
+}
+
+void test_follows_a_ramp()
+{
+  // 20 F/min, the setpoint trajectory moves with time
+  float duty = 0;
+  ThermalState state = {300, 300};
+  for (int t = 0; t < 300; t++)
+  {
+    for (int k = 0; k < MpcController::HORIZON; k++)
+    {
+      setpoints[k] = 300 + (t + k + 1) * 20.0 / 60;
+    }
+    duty = mpc.solve(state, FAN, MASS_G, setpoints, duty);
+    state = mpc.step(state, duty, FAN, MASS_G);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(2.0, 300 + 300 * 20.0 / 60, state.bean_f);
+}
+
+void test_solve_time()
+{
+  hold(400);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 1000; i++)
+  {
+    mpc.solve({70, 70}, FAN, MASS_G, setpoints, 0.5);
+  }
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  // generous on the host; the device reports its own worst case
+  TEST_ASSERT_LESS_THAN(1000, us / 1000.0);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_duty_in_bounds_and_saturates_when_far_below);
+  RUN_TEST(test_tracks_a_step_without_overshoot);
+  RUN_TEST(test_follows_a_ramp);
+  RUN_TEST(test_singular_holds_the_previous_duty);
+  RUN_TEST(test_solve_time);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "pid.h"
+#include "relay_autotuner.h"
+
+// First order plus dead time stand-in for the roaster: heater counts in,
+// bean temperature out, sampled at the thermocouple rate.
+const float DT_S = 0.25;
+const float FULL_SCALE = 4095;
+const float AMBIENT_F = 70;
+const float PLANT_GAIN = 500 / FULL_SCALE; // F above ambient per count
+const float PLANT_TAU_S = 90;
+const int DEAD_TIME_STEPS = 40; // 10s
+
+struct Plant
+{
+  float temp_f = AMBIENT_F;
+  float pipe[DEAD_TIME_STEPS] = {};
+  int head = 0;
+
+  float step(float output)
+  {
+    float delayed = pipe[head];
+    pipe[head] = output;
+    head = (head + 1) % DEAD_TIME_STEPS;
+    temp_f += DT_S * (PLANT_GAIN * delayed - (temp_f - AMBIENT_F)) / PLANT_TAU_S;
+    return temp_f;
+  }
+};
+
+const PidGains GAINS = {40, 0.4, 200};
+
+Pid pid(0, FULL_SCALE, 2.0);
+
+void setUp()
+{
+  pid = Pid(0, FULL_SCALE, 2.0);
+  pid.set_gains(GAINS);
+}
+
+void tearDown() {}
+
+void test_bumpless_initialize()
+{
+  pid.initialize(300, 300, 1234);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1234, pid.update(300, 300, DT_S));
+  // with an error the integral starts where the proportional term leaves off,
+  // so the output moves by one integration step only
+  pid.initialize(310, 300, 1234);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 1234 + GAINS.ki * 10 * DT_S, pid.update(310, 300, DT_S));
+}
+
+void test_no_derivative_kick_on_setpoint_step()
+{
+  pid.initialize(300, 300, 1000);
+  float before = pid.update(300, 300, DT_S);
+  float after = pid.update(310, 300, DT_S);
+  // only the proportional and one integration step, no kd * 10 / dt spike
+  TEST_ASSERT_FLOAT_WITHIN(0.01, GAINS.kp * 10 + GAINS.ki * 10 * DT_S, after - before);
+}
+
+void test_anti_windup()
+{
+  // Far below setpoint for ten minutes: output pinned at full scale
+  pid.initialize(450, 100, 0);
+  for (int i = 0; i < 2400; i++)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(0.01, FULL_SCALE, pid.update(450, 100, DT_S));
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(FULL_SCALE, pid.integral());
+  // Once past the setpoint the heater backs off right away
+  float output = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    output = pid.update(450, 455, DT_S);
+  }
+  TEST_ASSERT_LESS_THAN(FULL_SCALE, output);
+}
+
+float settle(Pid &controller, Plant &plant, float setpoint, float seconds, float *overshoot)
+{
+  float temp = plant.temp_f;
+  *overshoot = 0;
+  for (int i = 0; i < seconds / DT_S; i++)
+  {
+    temp = plant.step(controller.update(setpoint, temp, DT_S));
+    if (temp - setpoint > *overshoot)
+    {
+      *overshoot = temp - setpoint;
+    }
+  }
+  return temp;
+}
+
+void test_autotune_then_track()
+{
+  Plant plant;
+  // Warm up open loop to around the setpoint
+  while (plant.temp_f < 290)
+  {
+    plant.step(2800);
+  }
+
+  RelayAutotuner tuner;
+  float now_s = 0;
+  tuner.start(300, 2400, 1200, 0.5, now_s, 3600);
+  float temp = plant.temp_f;
+  while (tuner.state() == RelayAutotuner::RUNNING)
+  {
+    temp = plant.step(tuner.update(temp, now_s));
+    now_s += DT_S;
+  }
+  TEST_ASSERT_EQUAL(RelayAutotuner::DONE, tuner.state());
+  // dead time 10s and lag 90s put the ultimate period around 4 dead times
+  TEST_ASSERT_GREATER_THAN(20, tuner.ultimate_period_s());
+  TEST_ASSERT_LESS_THAN(80, tuner.ultimate_period_s());
+
+  Pid tuned(0, FULL_SCALE, 2.0);
+  tuned.set_gains(tuner.gains());
+  tuned.initialize(300, temp, 2400);
+  float overshoot;
+  TEST_ASSERT_FLOAT_WITHIN(1.0, 300, settle(tuned, plant, 300, 900, &overshoot));
+  // and a 40 degree step settles with modest overshoot
+  TEST_ASSERT_FLOAT_WITHIN(1.0, 340, settle(tuned, plant, 340, 900, &overshoot));
+  TEST_ASSERT_LESS_THAN(10, overshoot);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_bumpless_initialize);
+  RUN_TEST(test_no_derivative_kick_on_setpoint_step);
+  RUN_TEST(test_anti_windup);
+  RUN_TEST(test_autotune_then_track);
+  return UNITY_END();
+}
@@ -0,0 +1,98 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "pot_lut.h"
+
+// A log-ish taper, with every reference on a table node so the knots are exact
+const PotCalibration TAPER = {{160, 480, 960, 1600, 2240, 2880, 3360, 3680, 3840}};
+const PotTable TAPER_TABLE = make_pot_table(TAPER);
+
+static_assert(pot_calibration_valid(linear_pot_calibration()), "the default calibration must be usable");
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_default_table_is_linear()
+{
+  for (int counts = 0; counts <= POT_FULL_SCALE; counts++)
+  {
+    TEST_ASSERT_INT_WITHIN(1, counts, pot_position(DEFAULT_POT_TABLE, counts));
+  }
+}
+
+void test_reference_points_map_to_their_dial_positions()
+{
+  for (int i = 0; i < POT_REFERENCE_POINTS; i++)
+  {
+    int expected = (int)POT_REFERENCE_DIAL[i] * POT_FULL_SCALE / MAX_DIAL_HUNDREDTHS;
+    TEST_ASSERT_EQUAL_INT(expected, pot_position(TAPER_TABLE, TAPER.counts[i]));
+  }
+}
+
+void test_interpolates_between_reference_points()
+{
+  // Halfway between the 1 and 2 references
+  int expected = (100 + 200) / 2 * POT_FULL_SCALE / MAX_DIAL_HUNDREDTHS;
+  TEST_ASSERT_INT_WITHIN(1, expected, pot_position(TAPER_TABLE, (480 + 960) / 2));
+  // Off a table node
+  TEST_ASSERT_INT_WITHIN(1, 546 + (1092 - 546) * 7 / 480, pot_position(TAPER_TABLE, 480 + 7));
+}
+
+void test_position_never_falls_and_stays_in_range()
+{
+  int previous = 0;
+  for (int counts = 0; counts <= POT_FULL_SCALE; counts++)
+  {
+    int position = pot_position(TAPER_TABLE, counts);
+    TEST_ASSERT_TRUE(position >= previous);
+    TEST_ASSERT_TRUE(position <= POT_FULL_SCALE);
+    previous = position;
+  }
+  TEST_ASSERT_EQUAL_INT(0, pot_position(TAPER_TABLE, 0));
+  TEST_ASSERT_EQUAL_INT(POT_FULL_SCALE, pot_position(TAPER_TABLE, POT_FULL_SCALE));
+}
+
+void test_rejects_calibrations_that_do_not_rise()
+{
+  TEST_ASSERT_TRUE(pot_calibration_valid(TAPER));
+  PotCalibration flat = TAPER;
+  flat.counts[4] = flat.counts[3];
+  TEST_ASSERT_FALSE(pot_calibration_valid(flat));
+  PotCalibration reversed = TAPER;
+  reversed.counts[8] = 100;
+  TEST_ASSERT_FALSE(pot_calibration_valid(reversed));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_default_table_is_linear);
+  RUN_TEST(test_reference_points_map_to_their_dial_positions);
+  RUN_TEST(test_interpolates_between_reference_points);
+  RUN_TEST(test_position_never_falls_and_stays_in_range);
+  RUN_TEST(test_rejects_calibrations_that_do_not_rise);
+  return UNITY_END();
+}
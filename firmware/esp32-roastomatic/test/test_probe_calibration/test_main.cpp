@@ -0,0 +1,68 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "probe_calibration.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_identity_passes_through()
+{
+  for (float raw_f = -40; raw_f < 1900; raw_f += 0.45)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, raw_f, calibrate(PROBE_IDENTITY, raw_f));
+  }
+}
+
+void test_matches_the_float_polynomial()
+{
+  // Reads high by a growing amount, as the MAX6675 does
+  double a[4] = {-3.2, 0.985, -2.1e-5, 1.5e-8}; // per F^i
+  ProbeCalibration calibration = {};
+  for (int i = 0; i < 4; i++)
+  {
+    calibration.coefficients[i] = llround(a[i] * pow(256, i) * 65536);
+  }
+  for (float raw_f = 32; raw_f < 900; raw_f += 7.3)
+  {
+    double expected = a[0] + raw_f * (a[1] + raw_f * (a[2] + raw_f * a[3]));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, expected, calibrate(calibration, raw_f));
+  }
+}
+
+void test_open_probe_stays_nan()
+{
+  TEST_ASSERT_TRUE(isnan(calibrate(PROBE_IDENTITY, NAN)));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_identity_passes_through);
+  RUN_TEST(test_matches_the_float_polynomial);
+  RUN_TEST(test_open_probe_stays_nan);
+  return UNITY_END();
+}
@@ -0,0 +1,121 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "roast_profile.h"
+
+const ProfilePoint POINTS[] = {
+    {0, 2000, 800},
+    {60, 3000, 700},
+    {240, 3800, 600},
+    {600, 4300, 500},
+};
+const int NUM_POINTS = sizeof(POINTS) / sizeof(POINTS[0]);
+
+uint8_t blob[sizeof(RoastProfile)];
+size_t blob_length;
+RoastProfile profile;
+
+void setUp()
+{
+  RoastProfileHeader header = {};
+  header.magic = PROFILE_MAGIC;
+  header.version = PROFILE_VERSION;
+  header.flags = PROFILE_HAS_FAN;
+  header.num_points = NUM_POINTS;
+  memcpy(header.name, "test", 4);
+  header.checksum = profile_checksum((const uint8_t *)POINTS, sizeof(POINTS));
+  memcpy(blob, &header, sizeof(header));
+  memcpy(blob + sizeof(header), POINTS, sizeof(POINTS));
+  blob_length = profile_size(NUM_POINTS);
+}
+
+void tearDown() {}
+
+void test_load_accepts_good_blob()
+{
+  TEST_ASSERT_TRUE(profile_load(blob, blob_length, profile));
+  TEST_ASSERT_EQUAL(NUM_POINTS, profile.header.num_points);
+  TEST_ASSERT_EQUAL(4300, profile.points[3].bean_f_tenths);
+}
+
+void test_load_rejects_bad_blobs()
+{
+  TEST_ASSERT_FALSE(profile_load(blob, blob_length - 1, profile));
+  blob[sizeof(RoastProfileHeader) + 2] ^= 1; // a temperature
+  TEST_ASSERT_FALSE(profile_load(blob, blob_length, profile));
+  setUp();
+  blob[0] = 0;
+  TEST_ASSERT_FALSE(profile_load(blob, blob_length, profile));
+}
+
+void test_cursor_interpolates()
+{
+  profile_load(blob, blob_length, profile);
+  ProfileCursor cursor;
+  cursor.attach(&profile);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 200.0, cursor.at(0).bean_f);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 250.0, cursor.at(30).bean_f);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 340.0, cursor.at(150).bean_f);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, 0.65, cursor.at(150).fan_fraction);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 80.0 * 60 / 180, cursor.at(150).bean_f_per_minute);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 430.0, cursor.at(600).bean_f);
+}
+
+void test_cursor_holds_ends_and_rewinds()
+{
+  profile_load(blob, blob_length, profile);
+  ProfileCursor cursor;
+  cursor.attach(&profile);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 200.0, cursor.at(-5).bean_f);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 430.0, cursor.at(900).bean_f);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 0.0, cursor.at(900).bean_f_per_minute);
+  // a restarted roast goes back to the start
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 250.0, cursor.at(30).bean_f);
+}
+
+void test_cursor_walks_at_control_rate()
+{
+  profile_load(blob, blob_length, profile);
+  ProfileCursor cursor;
+  cursor.attach(&profile);
+  float last = 0;
+  for (int tick = 0; tick < 70000; tick++) // 700s at 100Hz
+  {
+    float bean_f = cursor.at(tick / 100.0).bean_f;
+    TEST_ASSERT_TRUE(bean_f >= last);
+    last = bean_f;
+  }
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_load_accepts_good_blob);
+  RUN_TEST(test_load_rejects_bad_blobs);
+  RUN_TEST(test_cursor_interpolates);
+  RUN_TEST(test_cursor_holds_ends_and_rewinds);
+  RUN_TEST(test_cursor_walks_at_control_rate);
+  return UNITY_END();
+}
@@ -0,0 +1,94 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "ror_estimator.h"
+
+const float PERIOD_S = 0.25;
+RorEstimator<60> ror(PERIOD_S);
+
+void setUp() { ror.reset(); }
+
+void tearDown() {}
+
+void test_not_ready_until_enough_samples()
+{
+  TEST_ASSERT_TRUE(isnan(ror.f_per_minute()));
+  for (int i = 0; i < 8; i++)
+  {
+    ror.add(200);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, ror.f_per_minute());
+}
+
+void test_ramp_while_filling_and_sliding()
+{
+  // 20 F/min is 1/12 F per sample
+  for (int i = 0; i < 1000; i++)
+  {
+    ror.add(300 + 20.0 * i * PERIOD_S / 60);
+    if (i >= 8)
+    {
+      TEST_ASSERT_FLOAT_WITHIN(0.05, 20.0, ror.f_per_minute());
+    }
+  }
+}
+
+void test_no_drift_over_a_long_roast()
+{
+  // an hour of a noisy plateau after a ramp still reads flat
+  for (int i = 0; i < 2400; i++)
+  {
+    ror.add(100 + i * 0.1);
+  }
+  for (int i = 0; i < 14400; i++)
+  {
+    ror.add(340 + ((i * 7919) % 5) * 0.25);
+  }
+  for (int i = 0; i < 60; i++)
+  {
+    ror.add(340);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, ror.f_per_minute());
+}
+
+void test_skips_nan()
+{
+  for (int i = 0; i < 60; i++)
+  {
+    ror.add(300 + i * 0.5);
+    ror.add(NAN);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 0.5 * 240, ror.f_per_minute());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_not_ready_until_enough_samples);
+  RUN_TEST(test_ramp_while_filling_and_sliding);
+  RUN_TEST(test_no_drift_over_a_long_roast);
+  RUN_TEST(test_skips_nan);
+  return UNITY_END();
+}
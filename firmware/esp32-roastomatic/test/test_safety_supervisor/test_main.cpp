@@ -0,0 +1,151 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <stdio.h>
+#include <unity.h>
+
+#include "safety_supervisor.h"
+
+const SafetySupervisor::Limits LIMITS = {500, 575, 1200, 50000};
+const uint32_t PERIOD_US = 1000; // supervisor interrupt
+const uint32_t CONTROL_US = 10000;
+
+SafetySupervisor *safety = nullptr;
+uint32_t now_us;
+
+void setUp()
+{
+  delete safety;
+  safety = new SafetySupervisor(LIMITS);
+  now_us = 0xFFFF0000; // wraps during the tests
+}
+
+void tearDown() {}
+
+// Steps the interrupt until it trips or time runs out
+SafetySupervisor::Trip run_until_trip(uint32_t limit_us)
+{
+  for (uint32_t t = 0; t < limit_us; t += PERIOD_US)
+  {
+    now_us += PERIOD_US;
+    SafetySupervisor::Trip trip = safety->check(now_us);
+    if (trip != SafetySupervisor::NONE)
+    {
+      return trip;
+    }
+  }
+  return SafetySupervisor::NONE;
+}
+
+void test_not_armed_before_first_report()
+{
+  TEST_ASSERT_EQUAL(SafetySupervisor::NONE, run_until_trip(200000));
+}
+
+void test_healthy_reports_never_trip()
+{
+  for (int i = 0; i < 1000; i++)
+  {
+    safety->report(now_us, 400, 500, 3000, 3000);
+    TEST_ASSERT_EQUAL(SafetySupervisor::NONE, run_until_trip(CONTROL_US));
+  }
+}
+
+void test_trips_within_one_period()
+{
+  struct
+  {
+    float bean, intake;
+    uint16_t heat, fan;
+    SafetySupervisor::Trip expected;
+  } faults[] = {
+      {501, 500, 0, 3000, SafetySupervisor::OVER_TEMPERATURE},
+      {400, 580, 0, 3000, SafetySupervisor::OVER_TEMPERATURE},
+      {NAN, 500, 0, 3000, SafetySupervisor::THERMOCOUPLE_OPEN},
+      {400, 500, 100, 1000, SafetySupervisor::FAN_TOO_LOW},
+  };
+  for (auto &fault : faults)
+  {
+    setUp();
+    safety->report(now_us, fault.bean, fault.intake, fault.heat, fault.fan);
+    TEST_ASSERT_EQUAL(fault.expected, run_until_trip(CONTROL_US));
+    TEST_ASSERT_LESS_OR_EQUAL(PERIOD_US, safety->latency_us());
+  }
+  printf("fault trip latency %u us (simulated %u us interrupt)\n", (unsigned)safety->max_latency_us(),
+         (unsigned)PERIOD_US);
+}
+
+void test_missed_heartbeat()
+{
+  safety->report(now_us, 400, 500, 3000, 3000);
+  TEST_ASSERT_EQUAL(SafetySupervisor::HEARTBEAT, run_until_trip(LIMITS.heartbeat_timeout_us + 2 * PERIOD_US));
+  TEST_ASSERT_LESS_OR_EQUAL(PERIOD_US, safety->latency_us());
+  printf("heartbeat trip latency %u us past the %u us timeout\n", (unsigned)safety->latency_us(),
+         (unsigned)LIMITS.heartbeat_timeout_us);
+}
+
+void test_latched_until_healthy_reset()
+{
+  safety->report(now_us, 501, 500, 0, 3000);
+  run_until_trip(CONTROL_US);
+  // clearing the fault alone doesn't clear the trip
+  safety->report(now_us, 400, 500, 0, 3000);
+  TEST_ASSERT_EQUAL(SafetySupervisor::OVER_TEMPERATURE, run_until_trip(CONTROL_US));
+  safety->report(now_us, 501, 500, 0, 3000);
+  TEST_ASSERT_FALSE(safety->reset());
+  safety->report(now_us, 400, 500, 0, 3000);
+  TEST_ASSERT_TRUE(safety->reset());
+  TEST_ASSERT_FALSE(safety->tripped());
+  TEST_ASSERT_EQUAL(1, safety->trips());
+}
+
+void test_heartbeat_held_over_a_flash_write()
+{
+  safety->report(now_us, 400, 500, 3000, 3000);
+  safety->hold();
+  TEST_ASSERT_EQUAL(SafetySupervisor::NONE, run_until_trip(4 * LIMITS.heartbeat_timeout_us));
+  safety->release(now_us);
+  // A full timeout again from the release
+  TEST_ASSERT_EQUAL(SafetySupervisor::NONE, run_until_trip(LIMITS.heartbeat_timeout_us));
+  TEST_ASSERT_EQUAL(SafetySupervisor::HEARTBEAT, run_until_trip(2 * PERIOD_US));
+}
+
+void test_hold_still_checks_temperatures()
+{
+  safety->report(now_us, 501, 500, 0, 3000);
+  safety->hold();
+  TEST_ASSERT_EQUAL(SafetySupervisor::OVER_TEMPERATURE, run_until_trip(CONTROL_US));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_not_armed_before_first_report);
+  RUN_TEST(test_healthy_reports_never_trip);
+  RUN_TEST(test_trips_within_one_period);
+  RUN_TEST(test_missed_heartbeat);
+  RUN_TEST(test_latched_until_healthy_reset);
+  RUN_TEST(test_heartbeat_held_over_a_flash_write);
+  RUN_TEST(test_hold_still_checks_temperatures);
+  return UNITY_END();
+}
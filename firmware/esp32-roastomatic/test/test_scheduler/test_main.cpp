@@ -0,0 +1,116 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include "scheduler.h"
+
+// Simulated clock; each job advances it by its own cost
+int64_t now_us = 0;
+int64_t clock_us() { return now_us; }
+
+uint32_t fast_cost_us = 0;
+uint32_t slow_cost_us = 0;
+int order[8];
+int order_count = 0;
+
+void fast_job()
+{
+  now_us += fast_cost_us;
+  order[order_count++ % 8] = 0;
+}
+void slow_job()
+{
+  now_us += slow_cost_us;
+  order[order_count++ % 8] = 1;
+}
+
+Job jobs[2];
+Scheduler scheduler(jobs, 2, clock_us);
+
+void setUp()
+{
+  now_us = 1000;
+  fast_cost_us = 10;
+  slow_cost_us = 10;
+  order_count = 0;
+  // name, run, period, priority, deadline, then the scheduler's bookkeeping
+  jobs[0] = {"fast", fast_job, 1000, 0, 500, 0, 0, 0, 0, 0};
+  jobs[1] = {"slow", slow_job, 4000, 1, 4000, 0, 0, 0, 0, 0};
+  scheduler.start();
+}
+
+void tearDown() {}
+
+void test_priority_breaks_ties()
+{
+  // both are due at start; the fast job has the higher priority
+  scheduler.run_due();
+  TEST_ASSERT_EQUAL(2, order_count);
+  TEST_ASSERT_EQUAL(0, order[0]);
+  TEST_ASSERT_EQUAL(1, order[1]);
+}
+
+void test_runs_at_period()
+{
+  for (int i = 0; i < 8; i++)
+  {
+    scheduler.run_due();
+    now_us += 500;
+  }
+  // 4ms of simulated time: fast every 1ms, slow every 4ms
+  TEST_ASSERT_EQUAL(4, scheduler.job(0).runs);
+  TEST_ASSERT_EQUAL(1, scheduler.job(1).runs);
+  TEST_ASSERT_EQUAL(0, scheduler.job(0).overruns);
+  TEST_ASSERT_EQUAL(0, scheduler.job(0).skipped);
+}
+
+void test_returns_time_to_next_release()
+{
+  int64_t wait = scheduler.run_due();
+  TEST_ASSERT_EQUAL(1000 - 20, wait);
+}
+
+void test_slow_job_skips_periods_and_counts_overruns()
+{
+  slow_cost_us = 3500; // blows the fast job's deadline and most of 4 periods
+  scheduler.run_due();
+  scheduler.run_due();
+  const Job &fast = scheduler.job(0);
+  TEST_ASSERT_EQUAL(1, scheduler.job(1).runs);
+  // fast ran once before slow, once after, instead of back to back four times
+  TEST_ASSERT_EQUAL(2, fast.runs);
+  TEST_ASSERT_EQUAL(1, fast.overruns);
+  TEST_ASSERT_EQUAL(2, fast.skipped);
+  TEST_ASSERT_EQUAL(3500, scheduler.job(1).max_run_us);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_priority_breaks_ties);
+  RUN_TEST(test_runs_at_period);
+  RUN_TEST(test_returns_time_to_next_release);
+  RUN_TEST(test_slow_job_skips_periods_and_counts_overruns);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include "temperature_kalman.h"
+
+const float DT_S = 0.25;
+const KalmanNoise NOISE = {3e-4, 0.5, 0.006, 70.0};
+TemperatureKalman kalman(NOISE, 30.0);
+
+void setUp() { kalman.reset(); }
+
+void tearDown() {}
+
+// Repeatable noise, roughly normal, and the MAX6675's quarter degree C steps
+float noisy(float temp_f, float sigma_f)
+{
+  float sum = 0;
+  for (int i = 0; i < 12; i++)
+  {
+    sum += (float)rand() / RAND_MAX;
+  }
+  float quantum_f = 0.45;
+  return roundf((temp_f + sigma_f * (sum - 6)) / quantum_f) * quantum_f;
+}
+
+void test_starts_at_the_first_reading()
+{
+  TEST_ASSERT_FALSE(kalman.ready());
+  TEST_ASSERT_TRUE(isnan(kalman.rate_f_per_minute()));
+  kalman.update(212.0, DT_S);
+  TEST_ASSERT_TRUE(kalman.ready());
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 212.0, kalman.temperature_f());
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, kalman.rate_f_per_minute());
+}
+
+void test_noise_grows_with_temperature()
+{
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.25, kalman.measurement_variance(20.0));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.25, kalman.measurement_variance(70.0));
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 1.1 * 1.1, kalman.measurement_variance(170.0));
+}
+
+void test_tracks_a_noisy_ramp()
+{
+  // 30 F/min with the hot probe's noise, as in a roast
+  srand(1);
+  float temp_f = 0;
+  float worst_rate = 0;
+  for (int i = 0; i < 2400; i++)
+  {
+    temp_f = 250 + 30.0 * i * DT_S / 60;
+    kalman.update(noisy(temp_f, 2.0), DT_S);
+    if (i >= 480) // settled after two minutes
+    {
+      float error = fabsf(kalman.rate_f_per_minute() - 30.0);
+      worst_rate = (error > worst_rate) ? error : worst_rate;
+    }
+  }
+  TEST_ASSERT_LESS_THAN(6.0, worst_rate);
+  TEST_ASSERT_FLOAT_WITHIN(1.5, temp_f, kalman.temperature_f());
+}
+
+void test_smoother_than_the_readings()
+{
+  srand(2);
+  float error2 = 0, raw2 = 0;
+  for (int i = 0; i < 2000; i++)
+  {
+    float reading = noisy(400, 2.5);
+    kalman.update(reading, DT_S);
+    if (i >= 400)
+    {
+      error2 += (kalman.temperature_f() - 400) * (kalman.temperature_f() - 400);
+      raw2 += (reading - 400) * (reading - 400);
+    }
+  }
+  TEST_ASSERT_LESS_THAN(raw2 / 10, error2);
+}
+
+void test_model_rate_pulls_the_rate()
+{
+  // Readings flat but noisy, the model expects 1 F/s: the rate moves toward it
+  srand(3);
+  for (int i = 0; i < 40; i++)
+  {
+    kalman.update(noisy(300, 2.0), DT_S, 1.0);
+  }
+  TEST_ASSERT_GREATER_THAN(5.0, kalman.rate_f_per_minute());
+}
+
+void test_undoes_probe_lag()
+{
+  // A 10s probe on beans rising 30 F/min reads 5F behind them
+  const float tau_s = 10.0;
+  float probe_f = 250;
+  float bean_f = 250;
+  for (int i = 0; i < 2400; i++)
+  {
+    bean_f = 250 + 30.0 * i * DT_S / 60;
+    probe_f += (DT_S / tau_s) * (bean_f - probe_f);
+    kalman.update(probe_f, DT_S);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.5, bean_f - 5.0, kalman.temperature_f());
+  TEST_ASSERT_FLOAT_WITHIN(0.5, bean_f, kalman.leading_f(tau_s));
+}
+
+void test_open_probe_clears()
+{
+  kalman.update(300, DT_S);
+  kalman.update(NAN, DT_S);
+  TEST_ASSERT_FALSE(kalman.ready());
+  TEST_ASSERT_TRUE(isnan(kalman.temperature_f()));
+  kalman.update(310, DT_S);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 310, kalman.temperature_f());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_at_the_first_reading);
+  RUN_TEST(test_noise_grows_with_temperature);
+  RUN_TEST(test_tracks_a_noisy_ramp);
+  RUN_TEST(test_smoother_than_the_readings);
+  RUN_TEST(test_model_rate_pulls_the_rate);
+  RUN_TEST(test_undoes_probe_lag);
+  RUN_TEST(test_open_probe_clears);
+  return UNITY_END();
+}
@@ -0,0 +1,160 @@
+// MIT License
+//
+// Copyright (c) Todd Jobe
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include "weight_estimator.h"
+
+const float DT_S = 0.1; // 10 samples per second
+const float COUNTS_PER_G = 420.5;
+const float EMPTY_COUNTS = 80000;
+const LoadCellDrift DRIFT = {30.0, 0.02, 70.0};
+const WeightNoise NOISE = {200.0, 50.0, 2.5e-3};
+WeightEstimator weights(DRIFT, NOISE);
+
+void setUp()
+{
+  weights.set_drift(DRIFT);
+  weights.reset();
+  srand(1);
+}
+
+void tearDown() {}
+
+float noise(float sigma)
+{
+  float sum = 0;
+  for (int i = 0; i < 12; i++)
+  {
+    sum += (float)rand() / RAND_MAX;
+  }
+  return sigma * (sum - 6);
+}
+
+// What the cell reads with grams on it at an intake temperature
+float reading(float grams, float intake_f)
+{
+  float d = intake_f - DRIFT.reference_f;
+  return EMPTY_COUNTS + d * (DRIFT.counts_per_f + d * DRIFT.counts_per_f2) + grams * COUNTS_PER_G +
+         noise(NOISE.reading_counts);
+}
+
+// Tare at preheat, then calibrate with the charge, as manual roast does
+void tare_and_calibrate(float intake_f, float grams)
+{
+  for (int i = 0; i < 50; i++)
+  {
+    TEST_ASSERT_TRUE(weights.zero(reading(0, intake_f), intake_f, DT_S));
+    weights.weigh(reading(0, intake_f), intake_f, DT_S);
+  }
+  float sum = 0;
+  for (int i = 0; i < 15; i++)
+  {
+    sum += reading(grams, intake_f);
+  }
+  weights.calibrate(sum / 15, grams, intake_f);
+}
+
+void test_counts_until_calibrated()
+{
+  TEST_ASSERT_FALSE(weights.zeroed());
+  for (int i = 0; i < 100; i++)
+  {
+    weights.weigh(reading(0, 70), 70, DT_S);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(100, EMPTY_COUNTS, weights.grams());
+}
+
+void test_zero_refuses_a_loaded_pan()
+{
+  for (int i = 0; i < 50; i++)
+  {
+    weights.zero(reading(0, 325), 325, DT_S);
+  }
+  TEST_ASSERT_TRUE(weights.zeroed());
+  TEST_ASSERT_FALSE(weights.zero(reading(90, 325), 325, DT_S));
+  TEST_ASSERT_FLOAT_WITHIN(100, EMPTY_COUNTS + 255 * 30 + 255 * 255 * 0.02, weights.zero_counts());
+}
+
+void test_tracks_drift_through_a_roast()
+{
+  tare_and_calibrate(325, 90.1);
+  // Ten minutes, the intake climbing to 450F and the beans losing 14g
+  float grams = 90.1;
+  float worst = 0;
+  for (int i = 0; i < 6000; i++)
+  {
+    float intake_f = 325 + 125.0 * i / 6000;
+    grams = 90.1 - 14.0 * i / 6000;
+    weights.weigh(reading(grams, intake_f), intake_f, DT_S);
+    if (i > 100)
+    {
+      float error = fabsf(weights.grams() - grams);
+      worst = (error > worst) ? error : worst;
+    }
+  }
+  TEST_ASSERT_LESS_THAN(0.5, worst);
+  TEST_ASSERT_LESS_THAN(1.0, weights.interval_g());
+  TEST_ASSERT_FLOAT_WITHIN(weights.interval_g(), grams, weights.grams());
+}
+
+void test_uncompensated_drift_is_grams_off()
+{
+  // The same roast with the temperature terms left out reads high by grams
+  weights.set_drift({0, 0, 70});
+  tare_and_calibrate(325, 90.1);
+  for (int i = 0; i < 6000; i++)
+  {
+    float intake_f = 325 + 125.0 * i / 6000;
+    weights.weigh(reading(76.1, intake_f), intake_f, DT_S);
+  }
+  TEST_ASSERT_GREATER_THAN(76.1 + 10, weights.grams());
+}
+
+void test_interval_widens_without_a_zero()
+{
+  tare_and_calibrate(325, 90.1);
+  for (int i = 0; i < 100; i++)
+  {
+    weights.weigh(reading(90.1, 325), 325, DT_S);
+  }
+  float early = weights.interval_g();
+  for (int i = 0; i < 6000; i++)
+  {
+    weights.weigh(reading(90.1, 325), 325, DT_S);
+  }
+  TEST_ASSERT_GREATER_THAN(early, weights.interval_g());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_until_calibrated);
+  RUN_TEST(test_zero_refuses_a_loaded_pan);
+  RUN_TEST(test_tracks_drift_through_a_roast);
+  RUN_TEST(test_uncompensated_drift_is_grams_off);
+  RUN_TEST(test_interval_widens_without_a_zero);
+  return UNITY_END();
+}
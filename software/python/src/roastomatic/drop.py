@@ -0,0 +1,163 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Check the drop countdown (include/drop_predictor.h) against logged roasts.
+
+    python -m roastomatic.drop data/roast_1.txt data/roast_2.txt --loss 15 --end 440
+
+Each roast's cook rows are replayed through the same predictor the firmware
+runs: least squares slopes of the weight and of the rate of rise over the
+last minute, applied to the latest weight and bean temperature. The
+countdown, and the firmware's own where the log streamed one, is compared
+with when the roast actually reached the sooner target, or was dropped if it
+reached neither. Prints the error a few horizons ahead of that moment.
+"""
+
+import argparse
+
+import numpy as np
+
+from roastomatic.log import read_log
+
+WINDOW = 60  # DROP_TREND_WINDOW
+PERIOD_S = 1.0  # DROP_TREND_PERIOD_S
+MIN_SAMPLES = 8  # RorEstimator
+HORIZONS_S = [30, 60, 120, 180, 300]
+
+
+def slope_per_minute(samples):
+    """RorEstimator::f_per_minute() over the samples, NAN until it's ready."""
+    if len(samples) < MIN_SAMPLES:
+        return np.nan
+    y = np.asarray(samples[-WINDOW:])
+    return np.polyfit(np.arange(len(y)), y, 1)[0] * 60 / PERIOD_S
+
+
+def seconds_to_loss(grams, rate_g_per_min, charge_g, loss_percent):
+    remaining_g = grams - charge_g * (1 - loss_percent / 100)
+    if remaining_g <= 0:
+        return 0.0
+    return remaining_g / rate_g_per_min * 60 if rate_g_per_min > 0 else np.nan
+
+
+def seconds_to_temperature(bean_f, ror_f_per_min, ror_change, end_f):
+    remaining_f = end_f - bean_f
+    if remaining_f <= 0:
+        return 0.0
+    change = min(ror_change, 0) if not np.isnan(ror_change) else 0
+    discriminant = ror_f_per_min**2 + 2 * change * remaining_f
+    if not (ror_f_per_min > 0 and discriminant >= 0):
+        return np.nan
+    return 2 * remaining_f / (ror_f_per_min + np.sqrt(discriminant)) * 60
+
+
+def cook(df):
+    """The ROAST rows with the bean temperature and rate the firmware uses.
+    Older logs fall back to the raw probe and the regression rate of rise."""
+    rows = df[df["state"] == "cook"].copy()
+    rows["bean_f"] = rows["bean_estimate_f"] if "bean_estimate_f" in rows else rows["bean_temp_f"]
+    rows["ror"] = rows["bean_rate_f_per_min"] if "bean_rate_f_per_min" in rows else rows["ror_f_per_min"]
+    return rows.dropna(subset=["weight", "bean_f", "ror"]).reset_index(drop=True)
+
+
+def replay(rows, charge_g, loss_percent, end_f):
+    """The predictor's countdown, one per row."""
+    weights = []
+    rors = []
+    since_sample_s = 0.0
+    countdown = np.full(len(rows), np.nan)
+    times = rows["roast_time"].to_numpy()
+    for k, row in enumerate(rows.itertuples()):
+        since_sample_s += times[k] - times[k - 1] if k else 0.0
+        if since_sample_s >= PERIOD_S:
+            since_sample_s -= PERIOD_S
+            weights.append(row.weight)
+            rors.append(row.ror)
+        loss_s = seconds_to_loss(row.weight, -slope_per_minute(weights), charge_g, loss_percent)
+        end_s = seconds_to_temperature(row.bean_f, row.ror, slope_per_minute(rors), end_f)
+        countdown[k] = np.fmin(loss_s, end_s)
+    return countdown
+
+
+def reached(df, rows, charge_g, loss_percent, end_f):
+    """Roast time the targets were met, and which, from the recorded data.
+    The weight is smoothed over a couple of seconds first."""
+    loss = 100 * (charge_g - rows["weight"].rolling(9, center=True, min_periods=1).median()) / charge_g
+    hits = rows.index[(loss >= loss_percent) | (rows["bean_f"] >= end_f)]
+    if len(hits):
+        k = hits[0]
+        return rows["roast_time"][k], "loss" if loss[k] >= loss_percent else "end"
+    dropped = df[df["state"] == "drop"]
+    if len(dropped):
+        return dropped["roast_time"].iloc[0], "dropped"
+    return np.nan, "unfinished"
+
+
+def errors(rows, countdown, truth_s):
+    """Predicted less actual time left, at each horizon ahead of truth_s."""
+    out = []
+    times = rows["roast_time"].to_numpy()
+    for horizon_s in HORIZONS_S:
+        k = np.searchsorted(times, truth_s - horizon_s)
+        near = k < len(times) and abs(times[k] - (truth_s - horizon_s)) <= PERIOD_S
+        out.append(countdown[k] - horizon_s if near else np.nan)
+    return np.array(out)
+
+
+def report(name, table):
+    print(f"{name:>8}" + "".join(f"{f'{h}s':>8}" for h in HORIZONS_S))
+    for label, row in table:
+        print(f"{label:>8}" + "".join(f"{e:8.0f}" for e in row))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log_paths", nargs="+")
+    parser.add_argument("--mass", type=float, default=90.1, help="bean charge, grams")
+    parser.add_argument("--loss", type=float, default=15.0, help="weight loss target, percent")
+    parser.add_argument("--end", type=float, default=440.0, help="bean temperature target, F")
+    args = parser.parse_args()
+
+    replayed = []
+    streamed = []
+    for path in args.log_paths:
+        df = read_log(path)
+        rows = cook(df)
+        truth_s, how = reached(df, rows, args.mass, args.loss, args.end)
+        if rows.empty or np.isnan(truth_s):
+            print(f"{path}: no finished roast")
+            continue
+        print(f"{path}: {how} at {truth_s:.0f}s, countdown error in s by time left")
+        table = [("replay", errors(rows, replay(rows, args.mass, args.loss, args.end), truth_s))]
+        replayed.append(table[0][1])
+        if "drop_countdown_s" in rows and rows["drop_countdown_s"].notna().any():
+            table.append(("firmware", errors(rows, rows["drop_countdown_s"].to_numpy(), truth_s)))
+            streamed.append(table[1][1])
+        report("", table)
+
+    if len(args.log_paths) > 1 and replayed:
+        print("mean absolute error in s")
+        summary = [("replay", np.nanmean(np.abs(replayed), axis=0))]
+        if streamed:
+            summary.append(("firmware", np.nanmean(np.abs(streamed), axis=0)))
+        report("", summary)
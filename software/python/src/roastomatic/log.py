@@ -0,0 +1,82 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+
+"""Read the roaster's serial log into a DataFrame.
+
+Rows are the manual roast csv telemetry. Lines starting with '#' are stats and
+command replies and are skipped, as is anything else that isn't a full row.
+"""
+
+# standard packages
+import csv
+
+# 3rd party packages
+import pandas as pd
+
+# In the order manual_roast_telemetry() prints them. Older logs stop early.
+COLUMNS = [
+    "roast_time",
+    "total_time",
+    "state",
+    "fan_value",
+    "heat_value",
+    "bean_temp_f",
+    "intake_temp_f",
+    "weight",
+    "drop_percent",
+    "heat_mode",
+    "setpoint_f",
+    "heat_output_duty",
+    "ror_f_per_min",
+    "ror_target",
+    "bean_estimate_f",
+    "bean_rate_f_per_min",
+    "intake_estimate_f",
+    "weight_interval_g",
+    "loss_percent_per_min",
+    "drop_loss_s",
+    "drop_end_s",
+    "drop_countdown_s",
+    "load_cell_counts",
+]
+TEXT_COLUMNS = {"state", "heat_mode"}
+BASE_COLUMNS = 9
+
+
+def read_log(path):
+    """Telemetry rows with times in seconds."""
+    rows = []
+    with open(path, newline="") as f:
+        for fields in csv.reader(line for line in f if not line.startswith("#")):
+            if BASE_COLUMNS <= len(fields) <= len(COLUMNS):
+                rows.append(fields)
+    width = max((len(fields) for fields in rows), default=BASE_COLUMNS)
+    rows = [fields for fields in rows if len(fields) == width]
+    df = pd.DataFrame(rows, columns=COLUMNS[:width])
+    for name in df.columns:
+        if name not in TEXT_COLUMNS:
+            df[name] = pd.to_numeric(df[name], errors="coerce")
+    for name in ["roast_time", "total_time"]:
+        df[name] = df[name] / 1000
+    return df.dropna(subset=["total_time"]).reset_index(drop=True)
@@ -0,0 +1,151 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Calibrate the roaster's thermocouples and send the result to its flash.
+
+    python -m roastomatic.probe fit points.csv bean --degree 2
+    python -m roastomatic.probe lag data/plunge.txt bean --port COM6
+
+fit: the csv has a header row and columns raw_f, the roaster's uncalibrated
+reading (reset the probe first with "probe bean reset"), and reference_f, a
+reference thermometer's at the same moment. Ice water, boiling water and a few
+points in the roasting range make a good set.
+
+lag: a logged plunge test, the probe moved quickly from room air into a hot
+bean bed or oil. The first order step response fit gives its time constant.
+
+Prints the "probe ..." command, or sends it with --port.
+"""
+
+import argparse
+import csv
+
+import numpy as np
+import serial
+from scipy.optimize import least_squares
+
+from roastomatic.log import read_log
+
+U_SCALE = 256  # include/probe_calibration.h: u = raw_f / 256
+Q = 1 << 16
+DEGREES = 3
+STEP_F = 3.0  # a plunge starts when the reading leaves its start by this much
+LAG_WINDOW_S = 180.0
+
+
+def fixed_point(poly):
+    """np.polyfit coefficients, highest power first, to the firmware's Q16 list."""
+    coefficients = [0] * (DEGREES + 1)
+    for power, a in enumerate(reversed(poly)):
+        coefficients[power] = round(a * U_SCALE**power * Q)
+    if any(abs(c) >= 1 << 31 for c in coefficients):
+        raise ValueError("calibration out of range for the firmware")
+    return coefficients
+
+
+def evaluate(coefficients, raw_f):
+    """What the firmware computes, in float."""
+    u = np.asarray(raw_f) / U_SCALE
+    return sum(c / Q * u**power for power, c in enumerate(coefficients))
+
+
+def fit_calibration(raw_f, reference_f, degree=2):
+    raw_f = np.asarray(raw_f, dtype=float)
+    reference_f = np.asarray(reference_f, dtype=float)
+    if not 1 <= degree <= DEGREES or len(raw_f) <= degree:
+        raise ValueError(f"need more than {degree} points for degree {degree}")
+    coefficients = fixed_point(np.polyfit(raw_f, reference_f, degree))
+    rms = np.sqrt(np.mean((evaluate(coefficients, raw_f) - reference_f) ** 2))
+    return coefficients, rms
+
+
+def read_points(path):
+    with open(path, newline="") as f:
+        rows = list(csv.DictReader(f))
+    return (
+        [float(row["raw_f"]) for row in rows],
+        [float(row["reference_f"]) for row in rows],
+    )
+
+
+def fit_lag(times_s, temps_f):
+    """Time constant of the first step in a plunge test, and the rms error."""
+    times_s = np.asarray(times_s, dtype=float)
+    temps_f = np.asarray(temps_f, dtype=float)
+    moved = np.nonzero(np.abs(temps_f - temps_f[0]) > STEP_F)[0]
+    if len(moved) == 0:
+        raise ValueError("no step in the log")
+    start = max(moved[0] - 1, 0)
+    window = (times_s >= times_s[start]) & (times_s <= times_s[start] + LAG_WINDOW_S)
+    t = times_s[window] - times_s[start]
+    y = temps_f[window]
+
+    def residuals(params):
+        initial_f, final_f, tau_s = params
+        return final_f + (initial_f - final_f) * np.exp(-t / tau_s) - y
+
+    result = least_squares(
+        residuals, [y[0], y[-1], 10.0], bounds=([-np.inf, -np.inf, 0.1], np.inf)
+    )
+    return result.x[2], np.sqrt(np.mean(result.fun**2))
+
+
+def send(port, line):
+    """Send a probe command and return the firmware's reply."""
+    with serial.Serial(port, 115200, timeout=2) as ser:
+        ser.write((line + "\n").encode("ascii"))
+        while True:
+            reply = ser.readline().decode("utf-8", errors="ignore").strip()
+            if not reply:
+                raise TimeoutError("no reply to probe")
+            if reply.startswith("# probe,invalid"):
+                raise RuntimeError(reply)
+            if reply.startswith("# probe,"):
+                return reply
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    fit_parser = commands.add_parser("fit", help="calibration polynomial from points")
+    fit_parser.add_argument("csv_path")
+    fit_parser.add_argument("probe", choices=["bean", "intake"])
+    fit_parser.add_argument("--degree", type=int, default=2)
+    fit_parser.add_argument("--port")
+    lag_parser = commands.add_parser("lag", help="time constant from a plunge test")
+    lag_parser.add_argument("log_path")
+    lag_parser.add_argument("probe", choices=["bean", "intake"])
+    lag_parser.add_argument("--port")
+    args = parser.parse_args()
+
+    if args.command == "fit":
+        coefficients, rms = fit_calibration(*read_points(args.csv_path), args.degree)
+        line = f"probe {args.probe} poly " + " ".join(str(c) for c in coefficients)
+    else:
+        df = read_log(args.log_path).dropna(subset=[f"{args.probe}_temp_f"])
+        tau_s, rms = fit_lag(df["total_time"], df[f"{args.probe}_temp_f"])
+        line = f"probe {args.probe} lag {tau_s:.1f}"
+    print(f"rms error {rms:.2f} F")
+    print(line)
+    if args.port:
+        print(send(args.port, line))
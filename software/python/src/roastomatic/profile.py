@@ -0,0 +1,142 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+
+"""Build roast profiles and upload them to the roaster's flash over serial.
+
+    python -m roastomatic.profile build city.csv city.bin --name city
+    python -m roastomatic.profile upload COM6 0 city.bin
+
+The csv has a header row and columns time_s, bean_f and, optionally, fan_percent.
+Pick the slot on the roaster with button 3 in manual roast; it is followed
+during ROAST with the heat in auto.
+"""
+
+# standard packages
+import argparse
+import csv
+import struct
+
+# 3rd party packages
+import serial
+
+# Matches firmware/esp32-roastomatic/include/roast_profile.h
+MAGIC = 0x46505252
+VERSION = 1
+HAS_FAN = 0x01
+MAX_POINTS = 64
+NAME_LENGTH = 12
+HEADER = struct.Struct("<IBBH12sHH")
+POINT = struct.Struct("<HHH")
+CHUNK = 24  # bytes per "roast data" line; the firmware reads 64 character lines
+
+
+def fletcher16(data):
+    sum1 = sum2 = 0
+    for byte in data:
+        sum1 = (sum1 + byte) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+def build(points, name=""):
+    """Profile blob from (time_s, bean_f, fan_percent or None) tuples."""
+    if not 2 <= len(points) <= MAX_POINTS:
+        raise ValueError(f"a profile needs 2 to {MAX_POINTS} points")
+    times = [time_s for time_s, _, _ in points]
+    if any(later <= earlier for earlier, later in zip(times, times[1:])):
+        raise ValueError("times must be strictly increasing")
+    has_fan = all(fan is not None for _, _, fan in points)
+    body = b"".join(
+        POINT.pack(
+            round(time_s),
+            round(bean_f * 10),
+            round(fan * 10) if has_fan else 0,
+        )
+        for time_s, bean_f, fan in points
+    )
+    header = HEADER.pack(
+        MAGIC,
+        VERSION,
+        HAS_FAN if has_fan else 0,
+        len(points),
+        name.encode("ascii")[:NAME_LENGTH],
+        fletcher16(body),
+        0,
+    )
+    return header + body
+
+
+def read_csv(path):
+    with open(path, newline="") as f:
+        rows = list(csv.DictReader(f))
+    return [
+        (
+            float(row["time_s"]),
+            float(row["bean_f"]),
+            float(row["fan_percent"]) if row.get("fan_percent") else None,
+        )
+        for row in rows
+    ]
+
+
+def upload(port, slot, blob):
+    """Send a blob to a slot and wait for the firmware to accept it."""
+    ser = serial.Serial(port, 115200, timeout=2)
+
+    def command(line, expect):
+        ser.write((line + "\n").encode("ascii"))
+        while True:
+            reply = ser.readline().decode("utf-8", errors="ignore").strip()
+            if not reply:
+                raise TimeoutError(f"no reply to {line.split()[1]}")
+            if reply.startswith("# roast,"):
+                if not reply.startswith("# roast," + expect):
+                    raise RuntimeError(reply)
+                return reply
+
+    command(f"roast begin {slot} {len(blob)}", "ready")
+    for i in range(0, len(blob), CHUNK):
+        command("roast data " + blob[i : i + CHUNK].hex(), "received")
+    command("roast end", "saved")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    build_parser = commands.add_parser("build", help="csv to profile blob")
+    build_parser.add_argument("csv_path")
+    build_parser.add_argument("bin_path")
+    build_parser.add_argument("--name", default="")
+    upload_parser = commands.add_parser("upload", help="store a blob in a slot")
+    upload_parser.add_argument("port")
+    upload_parser.add_argument("slot", type=int)
+    upload_parser.add_argument("bin_path")
+    args = parser.parse_args()
+
+    if args.command == "build":
+        with open(args.bin_path, "wb") as f:
+            f.write(build(read_csv(args.csv_path), args.name))
+    else:
+        with open(args.bin_path, "rb") as f:
+            upload(args.port, args.slot, f.read())
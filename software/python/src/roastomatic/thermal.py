@@ -0,0 +1,113 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+
+"""Fit the firmware's thermal model (include/mpc.h) to a logged roast.
+
+    python -m roastomatic.thermal data/roastomatic_20250224T181213.txt
+
+Prints the "mpc" command that loads the fitted model into the roaster.
+"""
+
+# standard packages
+import argparse
+
+# 3rd party packages
+import numpy as np
+from scipy.optimize import least_squares
+
+# local
+from roastomatic.log import read_log
+
+POT_FULL_SCALE = 4095
+MIN_FAN = 0.2  # MpcController::MIN_FAN
+STEP_S = 1.0
+INITIAL = [70.0, 300.0, 20.0, 120.0]  # DEFAULT_THERMAL_MODEL
+
+
+def resample(df, step_s=STEP_S):
+    """One row per model step."""
+    times = np.arange(df["total_time"].iloc[0], df["total_time"].iloc[-1], step_s)
+    out = {"total_time": times}
+    for name in ["fan", "heat", "bean_temp_f", "intake_temp_f", "mass_g"]:
+        out[name] = np.interp(times, df["total_time"], df[name])
+    return out
+
+
+def inputs(df, bean_mass_g):
+    """Heater and fan as fractions, from whatever the log has."""
+    df = df.dropna(subset=["bean_temp_f", "intake_temp_f"]).copy()
+    if "heat_output_duty" in df:
+        df["heat"] = df["heat_output_duty"] / 100
+    else:
+        df["heat"] = df["heat_value"] / POT_FULL_SCALE
+    df["fan"] = df["fan_value"] / POT_FULL_SCALE
+    df["mass_g"] = bean_mass_g
+    return df
+
+
+def simulate(params, data):
+    """The same two state model as MpcController, driven by the logged inputs."""
+    ambient_f, air_rise_f, air_tau_s, bean_tau_s_per_100g = params
+    air = data["intake_temp_f"][0]
+    bean = data["bean_temp_f"][0]
+    air_alpha = 1 - np.exp(-STEP_S / air_tau_s)
+    airs = np.empty_like(data["heat"])
+    beans = np.empty_like(data["heat"])
+    for k, (heat, fan, mass) in enumerate(zip(data["heat"], data["fan"], data["mass_g"])):
+        airs[k], beans[k] = air, bean
+        fan = max(fan, MIN_FAN)
+        bean_tau_s = max(bean_tau_s_per_100g * (mass / 100) / np.sqrt(fan), STEP_S)
+        bean_alpha = 1 - np.exp(-STEP_S / bean_tau_s)
+        air, bean = (
+            air + air_alpha * (ambient_f + air_rise_f / fan * heat - air),
+            bean + bean_alpha * (air - bean),
+        )
+    return airs, beans
+
+
+def fit(df, bean_mass_g=90.1):
+    data = resample(inputs(df, bean_mass_g))
+
+    def residuals(params):
+        airs, beans = simulate(params, data)
+        return np.concatenate(
+            [airs - data["intake_temp_f"], beans - data["bean_temp_f"]]
+        )
+
+    result = least_squares(
+        residuals, INITIAL, bounds=([0, 10, 1, 5], [150, 2000, 600, 3000])
+    )
+    rms = np.sqrt(np.mean(result.fun**2))
+    return result.x, rms
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log_path")
+    parser.add_argument("--mass", type=float, default=90.1, help="bean charge, grams")
+    args = parser.parse_args()
+
+    params, rms = fit(read_log(args.log_path), args.mass)
+    print(f"rms error {rms:.1f} F")
+    print("mpc " + " ".join(f"{p:.1f}" for p in params))
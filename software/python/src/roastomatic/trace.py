@@ -0,0 +1,176 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Pull the firmware's event trace over serial and convert it to a Chrome trace.
+
+    python -m roastomatic.trace pull COM6 roast.trace
+    python -m roastomatic.trace convert roast.trace roast.json
+
+Open the json in chrome://tracing or https://ui.perfetto.dev. The firmware
+must be built with -DROASTOMATIC_TRACE.
+"""
+
+# standard packages
+import argparse
+import base64
+import json
+import struct
+import time
+from datetime import datetime
+
+# 3rd party packages
+import serial
+
+# Matches trace_pack() in firmware/esp32-roastomatic/src/trace.cpp
+WIDE_TIME = struct.Struct("<I")
+DELTA_TIME = struct.Struct("<h")
+PHASES = "BEi"
+PREFIX = "# trace,"
+TASK_NAMES = {0: "core 0 (display/telemetry)", 1: "core 1 (control)"}
+
+
+def pull(port, trace_path, interval=1.0, log_path=None):
+    """Ask for the trace every interval seconds and append it to trace_path.
+
+    Everything else the firmware prints (the csv log) goes to log_path."""
+    if log_path is None:
+        start_time = datetime.now().strftime("%Y%m%dT%H%M%S")
+        log_path = f"data/roastomatic_{start_time}.txt"
+    ser = serial.Serial(port, 115200, timeout=0.1)
+    last_pull = 0.0
+    with open(trace_path, "a") as trace, open(log_path, "w") as log:
+        while True:
+            if time.monotonic() - last_pull >= interval:
+                ser.write(b"trace\n")
+                last_pull = time.monotonic()
+            line = ser.readline().decode("utf-8", errors="ignore").strip()
+            if not line:
+                continue
+            if line.startswith(PREFIX):
+                trace.write(line + "\n")
+            else:
+                log.write(line + "\n")
+
+
+def unpack(data, time_us):
+    """Yield (event, phase, time_us, core, arg) from one line of packed records.
+
+    time_us is the 32 bit time of the record before the line."""
+    i = 0
+    while i < len(data):
+        flags = data[i]
+        i += 1
+        if flags & 0x80:
+            (time_us,) = WIDE_TIME.unpack_from(data, i)
+            i += WIDE_TIME.size
+        else:
+            (delta,) = DELTA_TIME.unpack_from(data, i)
+            time_us = (time_us + delta) & 0xFFFFFFFF
+            i += DELTA_TIME.size
+        phase = PHASES[(flags >> 4) & 0x03]
+        arg = 0
+        if phase == "i":
+            arg = data[i]
+            i += 1
+        yield (flags & 0x0F, phase, time_us, (flags >> 6) & 0x01, arg)
+
+
+def read_records(lines):
+    """Yield (name, phase, time_us, core, arg) from raw '# trace,' lines.
+
+    Time stamps are unwrapped from 32 bits into a continuous microsecond clock."""
+    names = []
+    last_time = None
+    raw_time = 0
+    offset = 0
+    for line in lines:
+        line = line.strip()
+        if not line.startswith(PREFIX):
+            continue
+        body = line[len(PREFIX):]
+        if body.startswith("names,"):
+            names = body.split(",")[1:]
+            continue
+        if body.startswith("begin,"):
+            fields = body.split(",")
+            dropped = int(fields[3])
+            if dropped and last_time is not None:
+                yield ("dropped", "i", last_time, 0, dropped)
+            continue
+        if body.startswith("dropped,"):
+            if last_time is not None:
+                yield ("dropped", "i", last_time, 0, int(body.split(",")[1]))
+            continue
+        if body == "end":
+            continue
+
+        for event, phase, time_us, core, arg in unpack(base64.b64decode(body), raw_time):
+            raw_time = time_us
+            # Records from the two cores interleave slightly out of order, so
+            # only a jump back of more than half the range counts as a wrap.
+            if last_time is not None and time_us + offset < last_time - (1 << 31):
+                offset += 1 << 32
+            last_time = time_us + offset
+            name = names[event] if event < len(names) else f"event{event}"
+            yield (name, phase, last_time, core, arg)
+
+
+def to_chrome(records):
+    """Chrome trace event format, one thread per core."""
+    events = [
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": name}}
+        for tid, name in TASK_NAMES.items()
+    ]
+    for name, phase, time_us, core, arg in records:
+        event = {"name": name, "ph": phase, "ts": time_us, "pid": 1, "tid": core}
+        if phase == "i":
+            event["s"] = "t"
+            event["args"] = {"value": arg}
+        events.append(event)
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def convert(trace_path, json_path):
+    with open(trace_path) as f:
+        chrome = to_chrome(read_records(f))
+    with open(json_path, "w") as f:
+        json.dump(chrome, f)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    pull_parser = commands.add_parser("pull", help="record the trace from a running roaster")
+    pull_parser.add_argument("port")
+    pull_parser.add_argument("trace_path")
+    pull_parser.add_argument("--interval", type=float, default=1.0)
+    pull_parser.add_argument("--log", dest="log_path")
+    convert_parser = commands.add_parser("convert", help="write Chrome trace json")
+    convert_parser.add_argument("trace_path")
+    convert_parser.add_argument("json_path")
+    args = parser.parse_args()
+
+    if args.command == "pull":
+        pull(args.port, args.trace_path, args.interval, args.log_path)
+    else:
+        convert(args.trace_path, args.json_path)
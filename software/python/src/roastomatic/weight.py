@@ -0,0 +1,85 @@
+# MIT License
+#
+# Copyright (c) Todd Jobe
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""Fit the load cell's zero drift against intake temperature (include/weight_estimator.h).
+
+    python -m roastomatic.weight data/preheat_1.txt data/preheat_2.txt
+
+The logs are manual roasts, or just their preheats. Until tare the pan is
+empty, so every PREHEAT row's load_cell_counts, the decimated reading before
+any drift correction or filtering, is a zero at a known intake temperature.
+Each log gets its own zero; the drift terms are shared. The logged weight
+can't be used: it already has the drift in use taken out.
+
+Prints the "weight drift ..." command that loads the fit into the roaster.
+It replaces the drift in use, whatever that was.
+"""
+
+import argparse
+
+import numpy as np
+
+from roastomatic.log import read_log
+
+REFERENCE_F = 70.0
+
+
+def preheat(df):
+    if "load_cell_counts" not in df:
+        raise ValueError("log has no load_cell_counts column; record it with newer firmware")
+    rows = df[df["state"] == "heat"].dropna(subset=["load_cell_counts", "intake_temp_f"])
+    return rows["intake_temp_f"].to_numpy(), rows["load_cell_counts"].to_numpy()
+
+
+def fit(runs, reference_f=REFERENCE_F):
+    """runs: (intake_f, counts) arrays, one pair per log.
+
+    Returns counts per F, counts per F^2 and the rms residual in counts.
+    """
+    columns = []
+    targets = []
+    for k, (intake_f, counts) in enumerate(runs):
+        d = intake_f - reference_f
+        offsets = np.zeros((len(d), len(runs)))
+        offsets[:, k] = 1
+        columns.append(np.column_stack([d, d**2, offsets]))
+        targets.append(counts)
+    a = np.vstack(columns)
+    b = np.concatenate(targets)
+    if len(b) < len(runs) + 2:
+        raise ValueError("not enough preheat rows")
+    solution, *_ = np.linalg.lstsq(a, b, rcond=None)
+    rms = np.sqrt(np.mean((a @ solution - b) ** 2))
+    return solution[0], solution[1], rms
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log_paths", nargs="+")
+    parser.add_argument("--reference", type=float, default=REFERENCE_F, help="F")
+    args = parser.parse_args()
+
+    runs = [preheat(read_log(path)) for path in args.log_paths]
+    per_f, per_f2, rms = fit(runs, args.reference)
+    print(f"rms residual {rms:.0f} counts")
+    print(f"weight drift {per_f:.3f} {per_f2:.5f} {args.reference:.1f}")